@@ -0,0 +1,203 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace mylog
+{
+    // 线程绑核和内存节点的选项，默认不绑定
+    struct AffinityOptions
+    {
+        std::vector<int> cpus; // 绑定的CPU，为空时使用node的全部CPU
+        int node = -1;         // NUMA节点，-1表示不限定；缓冲区内存优先从该节点分配
+        bool per_node = false; // 每个NUMA节点一个后台线程，生产者固定写入首次写日志时所在节点的线程
+    };
+
+    // 解析"0-3,8,10-11"格式的CPU列表
+    inline std::vector<int> ParseCpuList(const std::string &list)
+    {
+        std::vector<int> cpus;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            if (item.empty() || item == "\n")
+            {
+                continue;
+            }
+            size_t dash = item.find('-');
+            int first = std::stoi(item.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    // NUMA拓扑，从/sys/devices/system/node读取，不依赖libnuma；读取失败时视为所有CPU在同一个节点
+    class NumaTopology
+    {
+    public:
+        static NumaTopology &GetInstance()
+        {
+            static NumaTopology instance;
+            return instance;
+        }
+
+        // 禁用拷贝和赋值
+        NumaTopology(const NumaTopology &) = delete;
+        NumaTopology &operator=(const NumaTopology &) = delete;
+
+        // 节点数
+        size_t NodeCount() const { return nodes_.size(); }
+
+        // 第i个节点的编号
+        int Node(size_t i) const { return nodes_[i]; }
+
+        // 节点上的CPU
+        const std::vector<int> &CpusOfNode(int node) const
+        {
+            for (size_t i = 0; i < nodes_.size(); ++i)
+            {
+                if (nodes_[i] == node)
+                {
+                    return cpus_[i];
+                }
+            }
+            return empty_;
+        }
+
+        // CPU所在的节点，未知时返回第一个节点
+        int NodeOfCpu(int cpu) const
+        {
+            if (cpu >= 0 && static_cast<size_t>(cpu) < cpu_node_.size() && cpu_node_[cpu] >= 0)
+            {
+                return cpu_node_[cpu];
+            }
+            return nodes_[0];
+        }
+
+        // 当前线程所在的节点
+        int CurrentNode() const
+        {
+            return NodeOfCpu(sched_getcpu());
+        }
+
+    private:
+        NumaTopology()
+        {
+            std::string online;
+            std::ifstream ifs("/sys/devices/system/node/online");
+            if (ifs && std::getline(ifs, online))
+            {
+                for (int node : ParseCpuList(online))
+                {
+                    std::ifstream list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                    std::string cpus;
+                    if (!list || !std::getline(list, cpus))
+                    {
+                        continue;
+                    }
+                    nodes_.push_back(node);
+                    cpus_.push_back(ParseCpuList(cpus));
+                    for (int cpu : cpus_.back())
+                    {
+                        if (static_cast<size_t>(cpu) >= cpu_node_.size())
+                        {
+                            cpu_node_.resize(cpu + 1, -1);
+                        }
+                        cpu_node_[cpu] = node;
+                    }
+                }
+            }
+            if (nodes_.empty())
+            {
+                nodes_.push_back(0);
+                cpus_.emplace_back();
+                for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_CONF); ++cpu)
+                {
+                    cpus_.back().push_back(static_cast<int>(cpu));
+                }
+            }
+        }
+
+        std::vector<int> nodes_;             // 在线的节点编号
+        std::vector<std::vector<int>> cpus_; // 各节点的CPU
+        std::vector<int> cpu_node_;          // CPU到节点的映射
+        std::vector<int> empty_;
+    };
+
+    // 选项对应的CPU集合：指定了CPU时使用指定的，否则使用节点的全部CPU，都没有时为空(不绑定)
+    inline std::vector<int> AffinityCpus(const AffinityOptions &options)
+    {
+        if (!options.cpus.empty() || options.node < 0)
+        {
+            return options.cpus;
+        }
+        return NumaTopology::GetInstance().CpusOfNode(options.node);
+    }
+
+    // 将线程绑定到cpus，cpus为空时不做任何事
+    inline bool PinThread(pthread_t thread, const std::vector<int> &cpus)
+    {
+        if (cpus.empty())
+        {
+            return true;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+        {
+            CPU_SET(cpu, &set);
+        }
+        int ret = pthread_setaffinity_np(thread, sizeof(set), &set);
+        if (ret != 0)
+        {
+            errno = ret;
+            std::cout << __FILE__ << __LINE__ << "pin thread failed" << std::endl;
+            perror(NULL);
+            return false;
+        }
+        return true;
+    }
+
+    // 让[addr, addr+len)内的整页优先从node分配，已分配的页迁移到node；node<0或内核不支持时不做任何事
+    inline void BindToNode(void *addr, size_t len, int node)
+    {
+        if (node < 0 || NumaTopology::GetInstance().NodeCount() < 2)
+        {
+            return;
+        }
+        constexpr int kMpolPreferred = 1;   // MPOL_PREFERRED
+        constexpr unsigned kMpolMfMove = 2; // MPOL_MF_MOVE
+        size_t page = sysconf(_SC_PAGESIZE);
+        uintptr_t begin = (reinterpret_cast<uintptr_t>(addr) + page - 1) / page * page;
+        uintptr_t end = (reinterpret_cast<uintptr_t>(addr) + len) / page * page;
+        if (begin >= end)
+        {
+            return;
+        }
+        unsigned long mask[16] = {0};
+        if (static_cast<size_t>(node) >= sizeof(mask) * 8)
+        {
+            return;
+        }
+        mask[node / (sizeof(unsigned long) * 8)] |= 1UL << (node % (sizeof(unsigned long) * 8));
+        if (syscall(SYS_mbind, begin, end - begin, kMpolPreferred, mask, sizeof(mask) * 8, kMpolMfMove) != 0)
+        {
+            std::cout << __FILE__ << __LINE__ << "mbind to node " << node << " failed" << std::endl;
+            perror(NULL);
+        }
+    }
+}
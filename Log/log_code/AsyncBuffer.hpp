@@ -1,29 +1,203 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
 #include <string>
 #include <cstddef>
 #include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "Util.hpp"
+#include "Affinity.hpp"
 
 extern mylog::Util::JsonData *g_conf_data;
 
 namespace mylog
 {
+    // 内存池统计
+    struct BlockPoolStats
+    {
+        std::atomic<uint64_t> mapped_bytes{0}; // 当前向系统申请的字节数(含池中空闲的)
+        std::atomic<uint64_t> cached_bytes{0}; // 池中空闲的字节数
+        std::atomic<uint64_t> hits{0};         // 从池中复用的次数
+        std::atomic<uint64_t> misses{0};       // 向系统申请的次数
+    };
+
+    // 缓冲区内存池，内存按固定大小的块管理，同样块数(且同一NUMA节点)的内存放在同一个空闲链表中复用
+    // 空闲内存总量不超过buffer_pool_bytes，超出部分直接归还系统；内存用mmap申请，不做清零和拷贝
+    // 该上限只约束池中空闲的内存，使用中的缓冲区仍按threshold/linear_growth扩容；需要限制使用中的内存时
+    // 应配置BLOCK/DROP_*等溢出策略，让生产者缓冲区不超过buffer_size(ERROR/FATAL日志仍可超出)
+    class BlockPool
+    {
+    public:
+        static BlockPool &GetInstance()
+        {
+            static BlockPool *pool = new BlockPool; // 不析构，静态对象中的缓冲区在退出时仍可归还
+            return *pool;
+        }
+
+        // 禁用拷贝和赋值
+        BlockPool(const BlockPool &) = delete;
+        BlockPool &operator=(const BlockPool &) = delete;
+
+        // 申请至少size字节，实际大小(块大小的整数倍)通过size返回；node>=0时内存优先从该NUMA节点分配
+        char *Acquire(size_t &size, int node = -1)
+        {
+            size = RoundUp(size);
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                auto it = free_.find(std::make_pair(size, node));
+                if (it != free_.end() && !it->second.empty())
+                {
+                    char *data = it->second.back();
+                    it->second.pop_back();
+                    cached_ -= size;
+                    stats_.cached_bytes.store(cached_, std::memory_order_relaxed);
+                    stats_.hits.fetch_add(1, std::memory_order_relaxed);
+                    return data;
+                }
+            }
+            stats_.misses.fetch_add(1, std::memory_order_relaxed);
+            stats_.mapped_bytes.fetch_add(size, std::memory_order_relaxed);
+            char *data = Map(size);
+            BindToNode(data, size, node); // 首次访问前绑定，页面直接在节点上分配
+            return data;
+        }
+
+        // 归还内存，池满时先淘汰最大的空闲内存
+        void Release(char *data, size_t size, int node = -1)
+        {
+            std::vector<std::pair<char *, size_t>> unmap;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (size <= max_cached_)
+                {
+                    while (cached_ + size > max_cached_ && !free_.empty())
+                    {
+                        auto it = std::prev(free_.end());
+                        if (it->second.empty())
+                        {
+                            free_.erase(it);
+                            continue;
+                        }
+                        unmap.emplace_back(it->second.back(), it->first.first);
+                        it->second.pop_back();
+                        cached_ -= it->first.first;
+                    }
+                    free_[std::make_pair(size, node)].push_back(data);
+                    cached_ += size;
+                    data = nullptr;
+                }
+                stats_.cached_bytes.store(cached_, std::memory_order_relaxed);
+            }
+            if (data != nullptr)
+            {
+                unmap.emplace_back(data, size);
+            }
+            for (auto &e : unmap)
+            {
+                munmap(e.first, e.second);
+                stats_.mapped_bytes.fetch_sub(e.second, std::memory_order_relaxed);
+            }
+        }
+
+        const BlockPoolStats &Stats() const { return stats_; }
+
+        // 向上取整到块大小的整数倍(即申请size字节时实际得到的大小)，使用大页时不小于一个大页的内存取整到大页
+        size_t RoundUp(size_t size) const
+        {
+            if (size == 0)
+            {
+                size = 1;
+            }
+            size = (size + block_size_ - 1) / block_size_ * block_size_;
+            if (hugepages_ && size >= kHugePageSize)
+            {
+                size = (size + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+            }
+            return size;
+        }
+
+    private:
+        static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+        BlockPool()
+            : block_size_(g_conf_data->buffer_block_size), max_cached_(g_conf_data->buffer_pool_bytes),
+              hugepages_(g_conf_data->use_hugepages)
+        {
+            size_t page = sysconf(_SC_PAGESIZE);
+            if (block_size_ < page)
+            {
+                block_size_ = page;
+            }
+            block_size_ = (block_size_ + page - 1) / page * page;
+        }
+
+        // 优先使用预留的大页，失败时退回普通页并建议内核使用透明大页
+        char *Map(size_t size)
+        {
+            void *data = MAP_FAILED;
+            if (hugepages_ && size % kHugePageSize == 0)
+            {
+                data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            }
+            if (data == MAP_FAILED)
+            {
+                data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (data == MAP_FAILED)
+                {
+                    std::cout << __FILE__ << __LINE__ << "mmap buffer failed" << std::endl;
+                    perror(NULL);
+                    stats_.mapped_bytes.fetch_sub(size, std::memory_order_relaxed);
+                    throw std::bad_alloc();
+                }
+                if (hugepages_ && size >= kHugePageSize)
+                {
+                    madvise(data, size, MADV_HUGEPAGE);
+                }
+            }
+            return static_cast<char *>(data);
+        }
+
+        size_t block_size_;  // 块大小
+        size_t max_cached_;  // 池中空闲内存的上限
+        bool hugepages_;     // 是否使用大页
+        std::mutex mutex_;
+        std::map<std::pair<size_t, int>, std::vector<char *>> free_; // 按大小和节点分组的空闲内存
+        size_t cached_ = 0;  // 池中空闲的字节数
+        BlockPoolStats stats_;
+    };
+
     class Buffer
     {
     public:
-        Buffer() : write_pos_(0), read_pos_(0)
+        Buffer() : Buffer(g_conf_data->buffer_size) {} // 使用全局配置数据中的缓冲区大小
+
+        // 指定初始大小(用于生产者线程的暂存缓冲区)，node>=0时内存优先从该NUMA节点分配
+        explicit Buffer(size_t size, int node = -1) : write_pos_(0), read_pos_(0), base_size_(size), size_(size), node_(node)
+        {
+            data_ = BlockPool::GetInstance().Acquire(size_, node_);
+        }
+
+        ~Buffer()
         {
-            // 初始化缓冲区大小，使用全局配置数据中的缓冲区大小
-            buffer_.resize(g_conf_data->buffer_size);
+            BlockPool::GetInstance().Release(data_, size_, node_);
         }
 
+        // 禁用拷贝和赋值，内存归属于唯一的缓冲区
+        Buffer(const Buffer &) = delete;
+        Buffer &operator=(const Buffer &) = delete;
+
         // 将数据写入缓冲区
         void Push(const char *data, size_t len)
         {
             ToBeEnough(len); // 确保缓冲区有足够的空间
-            std::copy(data, data + len, buffer_.begin() + write_pos_); // 将数据复制到缓冲区
+            memcpy(data_ + write_pos_, data, len); // 将数据复制到缓冲区
             write_pos_ += len; // 更新写指针位置
         }
 
@@ -31,7 +205,7 @@ namespace mylog
         char *ReadBegin(int len)
         {
             assert(len <= ReadableSize()); // 确保读取长度不超过可读大小
-            return &buffer_[read_pos_]; // 返回可读数据的起始地址
+            return data_ + read_pos_; // 返回可读数据的起始地址
         }
 
         // 判断缓冲区是否为空
@@ -43,7 +217,9 @@ namespace mylog
         // 交换两个缓冲区的内容
         void Swap(Buffer &buf)
         {
-            buffer_.swap(buf.buffer_); // 交换缓冲区内容
+            std::swap(data_, buf.data_); // 交换缓冲区内容
+            std::swap(size_, buf.size_);
+            std::swap(node_, buf.node_);
             std::swap(write_pos_, buf.write_pos_); // 交换写指针位置
             std::swap(read_pos_, buf.read_pos_); // 交换读指针位置
         }
@@ -51,7 +227,7 @@ namespace mylog
         // 获取缓冲区的可写大小
         size_t WriteableSize()
         {
-            return buffer_.size() - write_pos_; // 缓冲区总大小减去写指针位置
+            return size_ - write_pos_; // 缓冲区总大小减去写指针位置
         }
 
         // 获取缓冲区的可读大小
@@ -63,13 +239,19 @@ namespace mylog
         // 获取缓冲区的起始位置
         const char *Begin()
         {
-            return &buffer_[read_pos_]; // 返回读指针位置的地址
+            return data_ + read_pos_; // 返回读指针位置的地址
+        }
+
+        // 获取可写区域的起始位置，配合MoveWritePos直接在缓冲区内格式化
+        char *WriteBegin()
+        {
+            return data_ + write_pos_;
         }
 
         // 移动写指针位置
-        void MoveWritePos(int len)
+        void MoveWritePos(size_t len)
         {
-            assert(len <= ReadableSize()); // 确保移动长度不超过可读大小
+            assert(len <= WriteableSize()); // 确保移动长度不超过可写大小
             write_pos_ += len; // 更新写指针位置
         }
 
@@ -80,6 +262,22 @@ namespace mylog
             read_pos_ += len; // 更新读指针位置
         }
 
+        // 只保留前len个可读字节
+        void Truncate(size_t len)
+        {
+            assert(len <= ReadableSize());
+            write_pos_ = read_pos_ + len;
+        }
+
+        // 确保至少有len字节的可写空间
+        void Reserve(size_t len)
+        {
+            while (len >= WriteableSize())
+            {
+                ToBeEnough(len);
+            }
+        }
+
         // 重置缓冲区
         void Reset()
         {
@@ -87,29 +285,68 @@ namespace mylog
             write_pos_ = 0; // 重置写指针位置
         }
 
+        // 缓冲区为空且因突发写入扩容过时，把大块内存还给内存池并恢复初始大小，避免一次突发长期占用内存
+        void Shrink()
+        {
+            if (!IsEmpty() || size_ <= BlockPool::GetInstance().RoundUp(base_size_))
+            {
+                return;
+            }
+            Reallocate(base_size_, 0);
+        }
+
+        // 缓冲区当前的容量
+        size_t Capacity() const
+        {
+            return size_;
+        }
+
     protected:
         // 确保缓冲区有足够的空间
         void ToBeEnough(size_t len)
         {
-            int buffer_size = buffer_.size();
-            if (len >= WriteableSize()) // 如果需要写入的数据长度超过可写空间
+            if (len < WriteableSize())
             {
-                if (buffer_.size() < g_conf_data->threshold) // 如果缓冲区大小小于阈值
+                return;
+            }
+            size_t size = size_;
+            while (len >= size - ReadableSize()) // 如果需要写入的数据长度超过可写空间
+            {
+                size_t grow;
+                if (size < g_conf_data->threshold) // 如果缓冲区大小小于阈值
                 {
                     // 按倍数扩展缓冲区大小
-                    buffer_.resize(2 * buffer_.size() + buffer_size);
+                    grow = 2 * size;
                 }
                 else
                 {
                     // 如果缓冲区大小超过阈值，则线性增长
-                    buffer_.resize(g_conf_data->linear_growth + buffer_size);
+                    grow = g_conf_data->linear_growth;
                 }
+                // 每次至少增长len，size为0或linear_growth为0时也能结束
+                size += std::max(grow, len);
             }
+            Reallocate(size, ReadableSize());
+        }
+
+        // 换用至少size字节的新内存，只拷贝前keep个可读字节
+        void Reallocate(size_t size, size_t keep)
+        {
+            char *data = BlockPool::GetInstance().Acquire(size, node_);
+            memcpy(data, data_ + read_pos_, keep);
+            BlockPool::GetInstance().Release(data_, size_, node_);
+            data_ = data;
+            size_ = size;
+            read_pos_ = 0;
+            write_pos_ = keep;
         }
 
     protected:
-        std::vector<char> buffer_; // 缓冲区
-        size_t write_pos_;         // 写指针位置
-        size_t read_pos_;          // 读指针位置
+        char *data_;       // 缓冲区内存，来自内存池
+        size_t write_pos_; // 写指针位置
+        size_t read_pos_;  // 读指针位置
+        size_t base_size_; // 初始大小，收缩时恢复到该大小
+        size_t size_;      // 缓冲区总大小
+        int node_;         // 内存所在的NUMA节点，随内存一起交换
     };
 }
\ No newline at end of file
@@ -10,13 +10,16 @@
 
 #include "Util.hpp"
 #include "LogFlush.hpp"
+#include "QueuedFlush.hpp"
+#include "BackupFlush.hpp"
 #include "Message.hpp"
+#include "Format.hpp"
+#include "BinaryLog.hpp"
 #include "ThreadPool.hpp"
 #include "AsyncBuffer.hpp"
 #include "AsyncWorker.hpp"
 #include "Level.hpp"
-
-extern ThreadPool *thread_pool;
+#include "Affinity.hpp"
 
 namespace mylog
 {
@@ -27,144 +30,519 @@ namespace mylog
     using ptr = std::shared_ptr<AsyncLogger>;
 
     // 构造函数，初始化日志名称、日志输出方式和异步工作者
-    AsyncLogger(const std::string &logger_name, std::vector<LogFlush::ptr> &flushs, AsyncType type)
-        : logger_name_(logger_name), flushs_(flushs.begin(), flushs.end()),
-          async_worker_(std::make_shared<AsyncWorker>(std::bind(&AsyncLogger::RealFlush, this, std::placeholders::_1), type)) {}
+    // affinity.per_node且有多个NUMA节点时每个节点一个异步工作者，绑定到该节点的CPU，缓冲区从该节点分配
+    // backup不为空时ERROR/FATAL日志另外发送一份到远程备份服务器
+    AsyncLogger(const std::string &logger_name, std::vector<LogFlush::ptr> &flushs, AsyncType type, bool binary = false,
+                LogLevel::value level = LogLevel::value::DEBUG, const OverflowOptions &overflow = OverflowOptions(),
+                const AffinityOptions &affinity = AffinityOptions(), const BackupFlush::ptr &backup = BackupFlush::ptr())
+        : logger_name_(logger_name), flushs_(flushs.begin(), flushs.end()), level_(level), binary_(binary), decoded_(64 * 1024),
+          queued_(std::any_of(flushs_.begin(), flushs_.end(), [](const LogFlush::ptr &e)
+                              { return e->Queued(); })),
+          pool_(std::make_shared<BatchPool>()), backup_(backup)
+    {
+      NumaTopology &topology = NumaTopology::GetInstance();
+      if (affinity.per_node && topology.NodeCount() > 1)
+      {
+        for (size_t i = 0; i < topology.NodeCount(); ++i)
+        {
+          AffinityOptions node;
+          node.node = topology.Node(i);
+          AddWorker(type, overflow, node);
+        }
+      }
+      else
+      {
+        AddWorker(type, overflow, affinity);
+      }
+    }
 
     virtual ~AsyncLogger() {};
 
     // 获取日志名称
     std::string Name() { return logger_name_; }
 
+    // 设置最低输出级别，低于该级别的日志在格式化之前即被丢弃，可在运行时调整
+    void SetLevel(LogLevel::value level) { level_.store(level, std::memory_order_relaxed); }
+
+    // 获取最低输出级别
+    LogLevel::value GetLevel() const { return level_.load(std::memory_order_relaxed); }
+
+    // 指定级别的日志是否会被输出
+    bool ShouldLog(LogLevel::value level) const { return level >= level_.load(std::memory_order_relaxed); }
+
+    // 编译期关闭的日志宏展开为对该函数的调用，参数不会被求值
+    void NoLog() {}
+
+    // 立即提交所有线程暂存的日志
+    void FlushStaging()
+    {
+      for (auto &e : async_workers_)
+      {
+        e->FlushStaging();
+      }
+    }
+
+    // 异步工作者的数量(每个NUMA节点一个时大于1)
+    size_t WorkerCount() const { return async_workers_.size(); }
+
+    // 第i个异步工作者的缓冲区溢出时丢弃、采样和等待的统计
+    const OverflowStats &GetOverflowStats(size_t i = 0) const { return async_workers_[i]->GetOverflowStats(); }
+
     // 调试级别日志记录
-    void Debug(const std::string &file, size_t line, const std::string format, ...)
+    void Debug(const char *file, size_t line, const char *format, ...)
     {
-      va_list va;
-      va_start(va, format);
-      char *ret;
-      if (-1 == vasprintf(&ret, format.c_str(), va))
+      if (!ShouldLog(LogLevel::value::DEBUG))
       {
-        perror("vasprintf failed!!");
+        return;
       }
+      va_list va;
+      va_start(va, format);
+      serialize(LogLevel::value::DEBUG, file, line, format, va);
       va_end(va);
-      serialize(LogLevel::value::DEBUG, file, line, ret);
-      free(ret);
-      ret = nullptr;
     }
 
     // 信息级别日志记录
-    void Info(const std::string &file, size_t line, const std::string format, ...)
+    void Info(const char *file, size_t line, const char *format, ...)
     {
-      va_list va;
-      va_start(va, format);
-      char *ret;
-      if (-1 == vasprintf(&ret, format.c_str(), va))
+      if (!ShouldLog(LogLevel::value::INFO))
       {
-        perror("vasprintf failed!!");
+        return;
       }
+      va_list va;
+      va_start(va, format);
+      serialize(LogLevel::value::INFO, file, line, format, va);
       va_end(va);
-      serialize(LogLevel::value::INFO, file, line, ret);
-      free(ret);
-      ret = nullptr;
     }
 
     // 警告级别日志记录
-    void Warn(const std::string &file, size_t line, const std::string format, ...)
+    void Warn(const char *file, size_t line, const char *format, ...)
     {
-      va_list va;
-      va_start(va, format);
-      char *ret;
-      if (-1 == vasprintf(&ret, format.c_str(), va))
+      if (!ShouldLog(LogLevel::value::WARN))
       {
-        perror("vasprintf failed!!");
+        return;
       }
+      va_list va;
+      va_start(va, format);
+      serialize(LogLevel::value::WARN, file, line, format, va);
       va_end(va);
-      serialize(LogLevel::value::WARN, file, line, ret);
-      free(ret);
-      ret = nullptr;
     }
 
     // 错误级别日志记录
-    void Error(const std::string &file, size_t line, const std::string format, ...)
+    void Error(const char *file, size_t line, const char *format, ...)
     {
-      va_list va;
-      va_start(va, format);
-      char *ret;
-      if (-1 == vasprintf(&ret, format.c_str(), va))
+      if (!ShouldLog(LogLevel::value::ERROR))
       {
-        perror("vasprintf failed!!");
+        return;
       }
+      va_list va;
+      va_start(va, format);
+      serialize(LogLevel::value::ERROR, file, line, format, va);
       va_end(va);
-      serialize(LogLevel::value::ERROR, file, line, ret);
-      free(ret);
-      ret = nullptr;
     }
 
     // 致命错误级别日志记录
-    void Fatal(const std::string &file, size_t line, const std::string format, ...)
+    void Fatal(const char *file, size_t line, const char *format, ...)
     {
+      if (!ShouldLog(LogLevel::value::FATAL))
+      {
+        return;
+      }
       va_list va;
       va_start(va, format);
-      char *ret;
-      if (-1 == vasprintf(&ret, format.c_str(), va))
+      serialize(LogLevel::value::FATAL, file, line, format, va);
+      va_end(va);
+    }
+
+    // 以下为{}风格的类型安全接口，可与printf风格接口混用
+    // C++20下格式串在编译期解析和检查；C++17下MyLog.hpp中的宏为每个调用点传入fmt::FormatSite，
+    // 首次调用时在运行期解析并缓存，格式串有误时打印一次错误并原样输出该格式串
+    template <typename... Args>
+    void DebugFmt(const char *file, size_t line, fmt::FormatString<Args...> format, const Args &...args)
+    {
+      LogFmt(LogLevel::value::DEBUG, file, line, format, args...);
+    }
+
+    template <typename... Args>
+    void DebugFmt(const char *file, size_t line, fmt::FormatSite &site, const Args &...args)
+    {
+      LogFmt(LogLevel::value::DEBUG, file, line, site, args...);
+    }
+
+    template <typename... Args>
+    void InfoFmt(const char *file, size_t line, fmt::FormatString<Args...> format, const Args &...args)
+    {
+      LogFmt(LogLevel::value::INFO, file, line, format, args...);
+    }
+
+    template <typename... Args>
+    void InfoFmt(const char *file, size_t line, fmt::FormatSite &site, const Args &...args)
+    {
+      LogFmt(LogLevel::value::INFO, file, line, site, args...);
+    }
+
+    template <typename... Args>
+    void WarnFmt(const char *file, size_t line, fmt::FormatString<Args...> format, const Args &...args)
+    {
+      LogFmt(LogLevel::value::WARN, file, line, format, args...);
+    }
+
+    template <typename... Args>
+    void WarnFmt(const char *file, size_t line, fmt::FormatSite &site, const Args &...args)
+    {
+      LogFmt(LogLevel::value::WARN, file, line, site, args...);
+    }
+
+    template <typename... Args>
+    void ErrorFmt(const char *file, size_t line, fmt::FormatString<Args...> format, const Args &...args)
+    {
+      LogFmt(LogLevel::value::ERROR, file, line, format, args...);
+    }
+
+    template <typename... Args>
+    void ErrorFmt(const char *file, size_t line, fmt::FormatSite &site, const Args &...args)
+    {
+      LogFmt(LogLevel::value::ERROR, file, line, site, args...);
+    }
+
+    template <typename... Args>
+    void FatalFmt(const char *file, size_t line, fmt::FormatString<Args...> format, const Args &...args)
+    {
+      LogFmt(LogLevel::value::FATAL, file, line, format, args...);
+    }
+
+    template <typename... Args>
+    void FatalFmt(const char *file, size_t line, fmt::FormatSite &site, const Args &...args)
+    {
+      LogFmt(LogLevel::value::FATAL, file, line, site, args...);
+    }
+
+    // 二进制日志接口：生产者只拷贝调用点编号和原始参数，格式化推迟到后台线程
+    // site_fn返回调用点的静态信息，由MyLog.hpp中的宏为每个调用点生成；文本模式的日志器会立即格式化
+    template <typename SiteFn, typename... Args>
+    void LogBinary(SiteFn site_fn, fmt::FormatString<Args...> format, const Args &...args)
+    {
+      LogBinaryImpl(site_fn, format, args...);
+    }
+
+    template <typename SiteFn, typename... Args>
+    void LogBinary(SiteFn site_fn, fmt::FormatSite &format, const Args &...args)
+    {
+      LogBinaryImpl(site_fn, format, args...);
+    }
+
+    // 等待此前写入的所有日志落盘(包括各线程暂存的数据)，超时返回false
+    bool WaitDurable(std::chrono::milliseconds timeout = std::chrono::milliseconds(1000))
+    {
+      FlushStaging();
+      std::vector<uint64_t> tickets;
+      for (auto &e : async_workers_)
       {
-        perror("vasprintf failed!!");
+        tickets.push_back(e->RequestSync());
       }
-      va_end(va);
-      serialize(LogLevel::value::FATAL, file, line, ret);
-      free(ret);
-      ret = nullptr;
+      auto deadline = std::chrono::steady_clock::now() + timeout;
+      for (size_t i = 0; i < async_workers_.size(); ++i)
+      {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (!async_workers_[i]->WaitSynced(tickets[i], std::max(left, std::chrono::milliseconds(0))))
+        {
+          return false;
+        }
+      }
+      return true;
     }
 
   protected:
-    // 序列化日志信息，将日志信息格式化并传递给异步工作者
-    void serialize(LogLevel::value level, const std::string &file, size_t line, char *ret)
+    // {}风格接口的公共实现，format为fmt::BasicFormatString或fmt::FormatSite
+    template <typename Format, typename... Args>
+    void LogFmt(LogLevel::value level, const char *file, size_t line, Format &format, const Args &...args)
+    {
+      if (!ShouldLog(level))
+      {
+        return;
+      }
+      serialize(level, file, line, [&](LineWriter &w)
+                { fmt::Resolve<Args...>(format).Format(w, args...); });
+    }
+
+    template <typename SiteFn, typename Format, typename... Args>
+    void LogBinaryImpl(SiteFn site_fn, Format &format, const Args &...args)
+    {
+      const CallSite &site = site_fn();
+      if (!ShouldLog(site.level_))
+      {
+        return;
+      }
+      if (!binary_)
+      {
+        serialize(site.level_, site.file_, site.line_, [&](LineWriter &w)
+                  { fmt::Resolve<Args...>(format).Format(w, args...); });
+        return;
+      }
+      int64_t ts = Util::Date::NowNs();
+      uint64_t tid = LogMessage::ThreadIdNumber();
+      Worker()->PushFormatted([&](char *dst, size_t cap)
+                                   { return BinaryRecord::Encode(dst, cap, site.id_, ts, tid, args...); },
+                                   site.level_ >= LogLevel::value::ERROR);
+      SyncUrgent(site.level_);
+    }
+
+    // printf风格的日志内容
+    void serialize(LogLevel::value level, const char *file, size_t line, const char *format, va_list va)
+    {
+      serialize(level, file, line, [&](LineWriter &w)
+                { w.VPrintf(format, va); });
+    }
+
+    // 序列化日志信息，将日志头和payload写入的内容直接写入异步工作者的缓冲区
+    template <typename Payload>
+    void serialize(LogLevel::value level, const char *file, size_t line, Payload &&payload)
     {
-      LogMessage msg(file, line, level, logger_name_, ret);
-      std::string data = msg.format();
+      int64_t now = Util::Date::NowNs();
+      const std::string &tid = LogMessage::ThreadIdString();
+      // 二进制模式下已格式化的文本也封装为记录，文本前预留记录头
+      size_t prefix = binary_ ? BinaryRecord::kTextPrefix : 0;
+      auto writer = [&](char *dst, size_t cap)
+      {
+        LineWriter w(cap > prefix ? dst + prefix : nullptr, cap > prefix ? cap - prefix : 0);
+        LogMessage::FormatHeader(w, now, tid, level, logger_name_, file, line);
+        payload(w);
+        w.Append('\n');
+        if (binary_ && prefix + w.Length() <= cap)
+        {
+          BinaryRecord::EncodeTextPrefix(dst, w.Length(), now, LogMessage::ThreadIdNumber());
+        }
+        return prefix + w.Length();
+      };
 
-      // 对于紧急日志（FATAL或ERROR），进行备份
-      if (level == LogLevel::value::FATAL || level == LogLevel::value::ERROR)
+      // 对于紧急日志（FATAL或ERROR），进行备份；只追加到备份的发送批次，不等待网络
+      if (backup_ && (level == LogLevel::value::FATAL || level == LogLevel::value::ERROR))
       {
-        // try
-        // {
-        //   auto ret = thread_pool->enqueue(start_backup, data);
-        //   ret.get();
-        // }
-        // catch (const std::runtime_error &err)
-        // {
-        //   std::cout << __FILE__ << __LINE__ << "thread pool closed" << std::endl;
-        // }
+        static thread_local char local[4096];
+        LineWriter w(local, sizeof(local));
+        LogMessage::FormatHeader(w, now, tid, level, logger_name_, file, line);
+        payload(w);
+        w.Append('\n');
+        if (w.Fits())
+        {
+          backup_->Send(local, w.Length());
+        }
+        else
+        {
+          std::string big(w.Length(), '\0');
+          LineWriter retry(&big[0], big.size());
+          LogMessage::FormatHeader(retry, now, tid, level, logger_name_, file, line);
+          payload(retry);
+          retry.Append('\n');
+          backup_->Send(big.data(), big.size());
+        }
       }
 
-      // 将日志数据推送到异步工作者
-      Flush(data.c_str(), data.size());
+      // 将日志数据推送到异步工作者，紧急日志立即提交
+      Worker()->PushFormatted(writer, level >= LogLevel::value::ERROR);
+      SyncUrgent(level);
+    }
+
+    // 配置sync_on_error时，ERROR/FATAL日志请求立即落盘，FATAL日志等待落盘完成，避免随后的崩溃丢失它
+    void SyncUrgent(LogLevel::value level)
+    {
+      if (level < LogLevel::value::ERROR || !g_conf_data->sync_on_error)
+      {
+        return;
+      }
+      const AsyncWorker::ptr &worker = Worker();
+      uint64_t ticket = worker->RequestSync();
+      if (level == LogLevel::value::FATAL)
+      {
+        worker->WaitSynced(ticket, std::chrono::milliseconds(1000));
+      }
     }
 
     // 将日志数据推送到异步工作者
-    void Flush(const char *data, size_t len)
+    void Flush(const char *data, size_t len, bool urgent = false)
+    {
+      Worker()->PushStaged(data, len, urgent);
+    }
+
+    // 创建一个异步工作者
+    void AddWorker(AsyncType type, const OverflowOptions &overflow, const AffinityOptions &affinity)
+    {
+      async_workers_.push_back(std::make_shared<AsyncWorker>(std::bind(&AsyncLogger::RealFlush, this, std::placeholders::_1), type,
+                                                             std::bind(&AsyncLogger::WaitFlush, this),
+                                                             std::bind(&AsyncLogger::SyncFlush, this, std::placeholders::_1),
+                                                             overflow, affinity, binary_));
+      worker_nodes_.push_back(affinity.node);
+    }
+
+    // 当前线程写入的异步工作者：每个NUMA节点一个时固定为线程首次写日志时所在节点的工作者，保证同一线程的日志有序
+    const AsyncWorker::ptr &Worker()
     {
-      async_worker_->Push(data, len);
+      if (async_workers_.size() == 1)
+      {
+        return async_workers_[0];
+      }
+      static thread_local int node = NumaTopology::GetInstance().CurrentNode();
+      for (size_t i = 0; i < worker_nodes_.size(); ++i)
+      {
+        if (worker_nodes_[i] == node)
+        {
+          return async_workers_[i];
+        }
+      }
+      return async_workers_[0];
     }
 
     // 实际的日志刷新操作，将日志数据写入到指定的输出方式
     void RealFlush(Buffer &buffer)
     {
+      std::unique_lock<std::mutex> lock(mutex_); // 多个异步工作者时输出方式依次写入
       if (flushs_.empty())
       {
         return;
       }
+      if (queued_)
+      {
+        FanOut(buffer);
+        return;
+      }
+      if (!binary_)
+      {
+        // 最后一个输出方式可以直接接管缓冲区，工作器换回的是其已写完的空闲缓冲区
+        for (size_t i = 0; i + 1 < flushs_.size(); ++i)
+        {
+          flushs_[i]->Flush(buffer.Begin(), buffer.ReadableSize());
+        }
+        if (!flushs_.back()->TakeBuffer(buffer))
+        {
+          flushs_.back()->Flush(buffer.Begin(), buffer.ReadableSize());
+        }
+        return;
+      }
+      // 二进制模式：支持二进制的输出方式直接接收原始记录，其余的接收格式化后的文本
+      Buffer *text = nullptr;
+      for (auto &e : flushs_)
+      {
+        if (e->AcceptsBinary())
+        {
+          e->FlushBinary(logger_name_, buffer.Begin(), buffer.ReadableSize());
+          continue;
+        }
+        if (text == nullptr)
+        {
+          text = &Decode(buffer, decoded_);
+        }
+        e->Flush(text->Begin(), text->ReadableSize());
+      }
+    }
+
+    // 等待所有输出方式的异步写入完成，在后台线程退出前调用
+    void WaitFlush()
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      for (auto &e : flushs_)
+      {
+        e->Wait();
+      }
+    }
+
+    // 按落盘策略让各输出方式落盘，在后台线程调用
+    void SyncFlush(bool force)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
       for (auto &e : flushs_)
       {
-        e->Flush(buffer.Begin(), buffer.ReadableSize());
+        e->Sync(force);
       }
     }
 
+    // 存在排队的输出方式时，数据换入共享批次(工作器换回池中的空闲缓冲区)，
+    // 排队的输出方式只增加批次的引用，其余的输出方式仍在当前线程直接写入
+    void FanOut(Buffer &buffer)
+    {
+      Batch raw;
+      raw.buffer = pool_->Acquire();
+      raw.buffer->Swap(buffer);
+      raw.binary = binary_;
+      raw.logger_name = logger_name_;
+      Batch text;
+      if (!binary_)
+      {
+        text = raw;
+      }
+      for (auto &e : flushs_)
+      {
+        if (binary_ && e->AcceptsBinary())
+        {
+          Deliver(e, raw);
+          continue;
+        }
+        if (!text.buffer)
+        {
+          text.buffer = pool_->Acquire();
+          Decode(*raw.buffer, *text.buffer);
+        }
+        Deliver(e, text);
+      }
+    }
+
+    void Deliver(const LogFlush::ptr &flush, const Batch &batch)
+    {
+      if (flush->Queued())
+      {
+        flush->FlushBatch(batch);
+      }
+      else if (batch.binary)
+      {
+        flush->FlushBinary(logger_name_, batch.buffer->Begin(), batch.buffer->ReadableSize());
+      }
+      else
+      {
+        flush->Flush(batch.buffer->Begin(), batch.buffer->ReadableSize());
+      }
+    }
+
+    // 在后台线程将二进制记录格式化为文本，写入out
+    Buffer &Decode(Buffer &buffer, Buffer &out)
+    {
+      out.Reset();
+      const char *data = buffer.Begin();
+      size_t len = buffer.ReadableSize();
+      BinaryRecord::View view;
+      while (len > 0)
+      {
+        size_t n = BinaryRecord::Decode(data, len, view);
+        if (n == 0)
+        {
+          std::cout << __FILE__ << __LINE__ << "corrupted binary log record, " << len << " bytes dropped" << std::endl;
+          break;
+        }
+        out.Reserve(4096);
+        LineWriter w(out.WriteBegin(), out.WriteableSize());
+        BinaryRecord::Format(w, view, logger_name_);
+        if (!w.Fits())
+        {
+          out.Reserve(w.Length());
+          LineWriter retry(out.WriteBegin(), out.WriteableSize());
+          BinaryRecord::Format(retry, view, logger_name_);
+        }
+        out.MoveWritePos(w.Length());
+        data += n;
+        len -= n;
+      }
+      return out;
+    }
+
   private:
     std::mutex mutex_;                          // 互斥锁，保护共享资源
     std::string logger_name_;                   // 日志名称
     std::vector<LogFlush::ptr> flushs_;         // 日志输出方式集合
-    mylog::AsyncWorker::ptr async_worker_;      // 异步工作者，用于异步处理日志
+    std::atomic<LogLevel::value> level_;        // 最低输出级别
+    bool binary_;                               // 二进制模式，记录在后台线程格式化
+    Buffer decoded_;                            // 二进制记录格式化后的文本，仅后台线程使用
+    bool queued_;                               // 是否有在自己线程中排队写入的输出方式
+    BatchPool::ptr pool_;                       // 共享批次的缓冲区池
+    BackupFlush::ptr backup_;                   // ERROR/FATAL日志的远程备份，可为空
+    std::vector<mylog::AsyncWorker::ptr> async_workers_; // 异步工作者，用于异步处理日志，最后初始化
+    std::vector<int> worker_nodes_;             // 各异步工作者所在的NUMA节点
   };
 
   // 日志构建器类，用于构建异步日志对象
@@ -185,6 +563,37 @@ namespace mylog
       async_type_ = type;
     }
 
+    // 设置是否使用二进制模式(延迟到后台线程格式化)
+    void BuildLoggerBinary(bool binary = true)
+    {
+      binary_ = binary;
+    }
+
+    // 设置最低输出级别
+    void BuildLoggerLevel(LogLevel::value level)
+    {
+      level_ = level;
+    }
+
+    // 设置缓冲区满时的处理策略
+    void BuildLoggerOverflow(const OverflowOptions &overflow)
+    {
+      overflow_ = overflow;
+    }
+
+    // 设置后台线程绑定的CPU/NUMA节点，默认取配置中的worker_cpus和numa_per_node
+    void BuildLoggerAffinity(const AffinityOptions &affinity)
+    {
+      affinity_ = affinity;
+    }
+
+    // 设置ERROR/FATAL日志的远程备份，默认在配置backup_on_error时发送到backup_addr:backup_port
+    // 未指定options.name时取日志器名，各日志器的默认暂存文件互不相同；连接在Build时建立
+    void BuildLoggerBackup(const BackupOptions &options)
+    {
+      backup_options_.reset(new BackupOptions(options));
+    }
+
     // 添加日志输出方式
     template <typename FlushType, typename... Args>
     void BuildLoggerFlush(Args &&...args)
@@ -192,6 +601,14 @@ namespace mylog
       flushs_.emplace_back(LogFlushFactory::CreateLog<FlushType>(std::forward<Args>(args)...));
     }
 
+    // 添加在独立线程中排队写入的输出方式，队列超过max_bytes时按overflow处理
+    template <typename FlushType, typename... Args>
+    void BuildLoggerQueuedFlush(size_t max_bytes, SinkOverflow overflow, Args &&...args)
+    {
+      flushs_.emplace_back(std::make_shared<QueuedFlush>(
+          LogFlushFactory::CreateLog<FlushType>(std::forward<Args>(args)...), max_bytes, overflow));
+    }
+
     // 构建异步日志对象
     AsyncLogger::ptr Build()
     {
@@ -202,12 +619,46 @@ namespace mylog
       {
         flushs_.emplace_back(std::make_shared<StdoutFlush>());
       }
-      return std::make_shared<AsyncLogger>(logger_name_, flushs_, async_type_);
+      if (backup_options_)
+      {
+        if (backup_options_->name.empty())
+        {
+          backup_options_->name = logger_name_;
+        }
+        backup_ = std::make_shared<BackupFlush>(*backup_options_);
+      }
+      return std::make_shared<AsyncLogger>(logger_name_, flushs_, async_type_, binary_, level_, overflow_, affinity_, backup_);
     }
 
   private:
+    // 配置文件中的默认绑定选项
+    static AffinityOptions DefaultAffinity()
+    {
+      AffinityOptions affinity;
+      affinity.cpus = ParseCpuList(g_conf_data->worker_cpus);
+      affinity.per_node = g_conf_data->numa_per_node;
+      return affinity;
+    }
+
+    // 配置文件中的默认备份，所有日志器共用一个连接
+    static BackupFlush::ptr DefaultBackup()
+    {
+      if (!g_conf_data->backup_on_error)
+      {
+        return BackupFlush::ptr();
+      }
+      static BackupFlush::ptr backup = std::make_shared<BackupFlush>(BackupOptions::FromConfig());
+      return backup;
+    }
+
     std::string logger_name_ = "async_logger";  // 日志名称，默认为"async_logger"
     std::vector<mylog::LogFlush::ptr> flushs_; // 日志输出方式集合
     AsyncType async_type_ = AsyncType::ASYNC_SAFE; // 异步类型，默认为安全异步
+    bool binary_ = false;                          // 是否使用二进制模式
+    LogLevel::value level_ = LogLevel::value::DEBUG; // 最低输出级别
+    OverflowOptions overflow_;                     // 缓冲区满时的处理策略
+    AffinityOptions affinity_ = DefaultAffinity(); // 后台线程绑定的CPU/NUMA节点
+    BackupFlush::ptr backup_ = DefaultBackup();    // ERROR/FATAL日志的远程备份
+    std::unique_ptr<BackupOptions> backup_options_; // BuildLoggerBackup设置的备份选项，Build时创建连接
   };
 }
@@ -1,12 +1,17 @@
 #pragma once
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <iostream>
 #include <mutex>
 #include <thread>
+#include <vector>
+#include <algorithm>
+#include <string>
 
 #include "AsyncBuffer.hpp"
+#include "RingBuffer.hpp"
 
 namespace mylog
 {
@@ -14,7 +19,37 @@ namespace mylog
     enum class AsyncType
     {
         ASYNC_SAFE,  // 线程安全的异步模式
-        ASYNC_UNSAFE // 非线程安全的异步模式
+        ASYNC_UNSAFE, // 非线程安全的异步模式
+        ASYNC_LOCKFREE // 无锁多生产者单消费者模式
+    };
+
+    // 共享缓冲区满时的溢出策略，ERROR/FATAL日志在任何策略下都不会被丢弃，必要时超出容量
+    enum class OverflowPolicy
+    {
+        DEFAULT,     // 沿用异步类型的行为：ASYNC_SAFE无限等待，ASYNC_UNSAFE无限扩容，ASYNC_LOCKFREE自旋等待
+        BLOCK,       // 最多等待timeout，超时丢弃
+        DROP_NEWEST, // 丢弃新日志
+        DROP_OLDEST, // 丢弃缓冲区中最早的低级别数据块(无锁模式下同DROP_NEWEST)
+        SAMPLE       // 超过水位线后按sample_rate概率保留，满时丢弃
+    };
+
+    // 溢出策略参数
+    struct OverflowOptions
+    {
+        OverflowPolicy policy = OverflowPolicy::DEFAULT;
+        std::chrono::milliseconds timeout{10}; // BLOCK的最长等待时间
+        double watermark = 0.75;               // SAMPLE开始采样的水位线(占容量的比例)
+        double sample_rate = 0.1;              // SAMPLE超过水位线后的保留概率
+    };
+
+    // 溢出统计
+    struct OverflowStats
+    {
+        std::atomic<uint64_t> dropped{0};       // 因缓冲区满丢弃的日志条数
+        std::atomic<uint64_t> dropped_bytes{0}; // 丢弃的字节数(格式化前即丢弃的不计)
+        std::atomic<uint64_t> sampled{0};       // 因采样丢弃的日志条数
+        std::atomic<uint64_t> delayed{0};       // 因缓冲区满而等待的日志条数
+        std::atomic<uint64_t> delayed_ns{0};    // 累计等待时间(纳秒)
     };
 
     using functor = std::function<void(Buffer &)>; // 回调函数类型
@@ -24,70 +59,748 @@ namespace mylog
     public:
         using ptr = std::shared_ptr<AsyncWorker>; // 智能指针类型定义
 
-        // 构造函数，初始化异步工作器
-        AsyncWorker(const functor &cb, AsyncType async_type = AsyncType::ASYNC_SAFE)
-            : async_type_(async_type), stop_(false), callback_(cb), thread_(std::thread(&AsyncWorker::ThreadEntry, this))
+        // 构造函数，初始化异步工作器，on_exit在消费者线程退出前调用
+        // on_sync(force)在每批数据处理后和空闲醒来时调用，force为真表示有落盘请求需要立即落盘
+        // affinity指定消费者线程绑定的CPU和共享缓冲区所在的NUMA节点
+        // binary表示数据是二进制记录，无锁模式下超过单条记录上限的数据不能拆分
+        AsyncWorker(const functor &cb, AsyncType async_type = AsyncType::ASYNC_SAFE,
+                    const std::function<void()> &on_exit = nullptr,
+                    const std::function<void(bool)> &on_sync = nullptr,
+                    const OverflowOptions &overflow = OverflowOptions(),
+                    const AffinityOptions &affinity = AffinityOptions(),
+                    bool binary = false)
+            : async_type_(async_type), binary_(binary), stop_(false), overflow_(overflow),
+              buffer_producer_(g_conf_data->buffer_size, affinity.node), buffer_consumer_(g_conf_data->buffer_size, affinity.node),
+              callback_(cb), on_exit_(on_exit), on_sync_(on_sync), cpus_(AffinityCpus(affinity))
         {
+            capacity_ = g_conf_data->buffer_size;
+            if (async_type_ == AsyncType::ASYNC_LOCKFREE)
+            {
+                ring_.reset(new RingBuffer(g_conf_data->buffer_size, affinity.node));
+                capacity_ = ring_->Capacity();
+            }
+            // 暂存数据整批交给共享缓冲区，无锁模式下一批不能超过环形缓冲区的单条记录上限
+            staging_limit_ = ring_ ? std::min<size_t>(g_conf_data->staging_size, ring_->MaxRecordSize()) : g_conf_data->staging_size;
+            staging_interval_ = std::chrono::milliseconds(g_conf_data->staging_interval);
+            // 启用暂存或组提交时消费者需要定时醒来
+            if (g_conf_data->staging_size != 0 && staging_interval_.count() != 0)
+            {
+                tick_ = staging_interval_;
+            }
+            if (g_conf_data->flush_log == 3 && g_conf_data->sync_interval != 0 &&
+                (tick_.count() == 0 || g_conf_data->sync_interval < static_cast<size_t>(tick_.count())))
+            {
+                tick_ = std::chrono::milliseconds(g_conf_data->sync_interval);
+            }
+            thread_ = std::thread(&AsyncWorker::ThreadEntry, this);
         }
 
-        // 将数据推入生产者缓冲区
-        void Push(const char *data, size_t len)
+        ~AsyncWorker()
         {
+            Stop();
+        }
+
+        // 将数据推入生产者缓冲区，data包含records条日志，urgent表示其中有ERROR/FATAL日志
+        void Push(const char *data, size_t len, size_t records = 1, bool urgent = false)
+        {
+            if (ring_)
+            {
+                PushLockFree(data, len, records, urgent);
+                return;
+            }
             std::unique_lock<std::mutex> lock(mutex_);
-            if (AsyncType::ASYNC_SAFE == async_type_)
+            if (!MakeRoom(lock, len, records, urgent))
+            {
+                return;
+            }
+            Append(data, len, records, urgent); // 将数据写入生产者缓冲区
+            cv_consumer_.notify_one();          // 通知消费者线程
+        }
+
+        // 通过当前线程的暂存缓冲区写入，写满、超时或紧急(urgent)时才交给消费者
+        void PushStaged(const char *data, size_t len, bool urgent = false)
+        {
+            if (!Admit(urgent))
             {
-                // 如果是线程安全模式，等待缓冲区有足够的可写空间
-                cv_producer_.wait(lock, [this, len]()
-                                  { return len <= this->buffer_producer_.WriteableSize(); });
+                return;
             }
-            buffer_producer_.Push(data, len); // 将数据写入生产者缓冲区
-            cv_consumer_.notify_one();       // 通知消费者线程
+            Stage(data, len, urgent);
+        }
+
+        // 直接在暂存缓冲区(或线程本地缓冲区)中格式化一条记录，避免中间字符串和堆分配
+        // writer(dst, cap)按snprintf语义写入整条记录并返回其完整长度
+        template <typename Writer>
+        void PushFormatted(Writer &&writer, bool urgent = false)
+        {
+            if (!Admit(urgent))
+            {
+                return; // 在格式化之前丢弃
+            }
+            Staging *s = g_conf_data->staging_size != 0 ? LocalStaging() : nullptr;
+            if (s != nullptr)
+            {
+                std::unique_lock<std::mutex> lock(s->mutex);
+                if (!s->detached)
+                {
+                    if (Room(*s) < kFormatReserve)
+                    {
+                        HandOff(*s);
+                    }
+                    size_t room = Room(*s);
+                    size_t n = writer(s->buffer.WriteBegin(), room);
+                    if (n <= room)
+                    {
+                        auto now = std::chrono::steady_clock::now();
+                        if (s->buffer.IsEmpty())
+                        {
+                            s->first = now;
+                        }
+                        s->buffer.MoveWritePos(n);
+                        ++s->records;
+                        if (urgent || (staging_interval_.count() > 0 && now - s->first >= staging_interval_))
+                        {
+                            HandOff(*s, urgent);
+                        }
+                        return;
+                    }
+                }
+            }
+            static thread_local char local[kFormatReserve];
+            size_t n = writer(local, sizeof(local));
+            if (n <= sizeof(local))
+            {
+                Stage(local, n, urgent);
+                return;
+            }
+            // 超长记录退回到堆上格式化
+            std::string big(n, '\0');
+            writer(&big[0], big.size());
+            Stage(big.data(), big.size(), urgent);
+        }
+
+        // 溢出统计
+        const OverflowStats &GetOverflowStats() const { return overflow_stats_; }
+
+        // 将所有线程暂存的数据交给消费者
+        void FlushStaging()
+        {
+            DrainStaging(false);
+        }
+
+        // 请求一次落盘，返回请求编号；此前已写入共享缓冲区的数据都会在该请求完成前落盘
+        uint64_t RequestSync()
+        {
+            uint64_t ticket = sync_requested_.fetch_add(1, std::memory_order_seq_cst) + 1;
+            if (!ring_ || sleeping_.load(std::memory_order_seq_cst))
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_consumer_.notify_one();
+            }
+            return ticket;
+        }
+
+        // 等待编号为ticket的落盘请求完成，超时返回false
+        bool WaitSynced(uint64_t ticket, std::chrono::milliseconds timeout)
+        {
+            std::unique_lock<std::mutex> lock(sync_mutex_);
+            return sync_cv_.wait_for(lock, timeout, [this, ticket]()
+                                     { return sync_done_.load() >= ticket; });
         }
 
         // 停止异步工作器
         void Stop()
         {
-            stop_ = true;               // 设置停止标志
+            if (!thread_.joinable())
+            {
+                return;
+            }
+            DrainStaging(true); // 先提交所有暂存数据，之后的写入直接进入共享缓冲区
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                stop_ = true;           // 设置停止标志
+            }
             cv_consumer_.notify_all();  // 唤醒所有消费者线程
             thread_.join();             // 等待工作线程结束
         }
 
     private:
+        static constexpr size_t kFormatReserve = 4096; // 原地格式化时预留的空间
+        static constexpr std::chrono::milliseconds kLockFreeTick{10}; // 无锁模式消费者的最长休眠时间
+
+        // 写入暂存缓冲区，未启用暂存或工作器已停止时直接提交
+        void Stage(const char *data, size_t len, bool urgent)
+        {
+            if (g_conf_data->staging_size == 0)
+            {
+                Push(data, len, 1, urgent);
+                return;
+            }
+            Staging *s = LocalStaging();
+            if (s == nullptr)
+            {
+                Push(data, len, 1, urgent);
+                return;
+            }
+            std::unique_lock<std::mutex> lock(s->mutex);
+            if (s->detached)
+            {
+                lock.unlock();
+                Push(data, len, 1, urgent);
+                return;
+            }
+            if (len > Room(*s))
+            {
+                HandOff(*s);
+            }
+            if (len > staging_limit_)
+            {
+                Push(data, len, 1, urgent); // 超大记录直接提交，此前的暂存数据已先行提交，顺序不变
+                return;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (s->buffer.IsEmpty())
+            {
+                s->first = now;
+            }
+            s->buffer.Push(data, len);
+            ++s->records;
+            if (urgent || (staging_interval_.count() > 0 && now - s->first >= staging_interval_))
+            {
+                HandOff(*s, urgent);
+            }
+        }
+
+        // 生产者线程的暂存缓冲区，仅在清扫或停止时才会与其他线程竞争锁
+        struct Staging
+        {
+            Staging(AsyncWorker *w) : owner(w), buffer(g_conf_data->staging_size) {}
+            std::mutex mutex;
+            AsyncWorker *owner;                         // 所属工作器
+            std::atomic<bool> detached{false};          // 工作器已停止，不再暂存
+            mylog::Buffer buffer;                       // 暂存数据
+            size_t records = 0;                         // 暂存的日志条数
+            std::chrono::steady_clock::time_point first; // 首条暂存数据的写入时间
+        };
+
+        // 线程退出时提交该线程所有的暂存数据
+        struct StagingHolder
+        {
+            std::vector<std::shared_ptr<Staging>> items;
+            ~StagingHolder()
+            {
+                for (auto &s : items)
+                {
+                    std::unique_lock<std::mutex> lock(s->mutex);
+                    if (!s->detached)
+                    {
+                        s->owner->HandOff(*s);
+                        s->owner->Unregister(s.get());
+                        s->detached = true;
+                    }
+                }
+            }
+        };
+
+        // 获取当前线程在本工作器上的暂存缓冲区，不存在则创建并注册；工作器已停止时返回nullptr
+        Staging *LocalStaging()
+        {
+            static thread_local StagingHolder holder;
+            for (auto &s : holder.items)
+            {
+                if (s->owner == this && !s->detached)
+                {
+                    return s.get();
+                }
+            }
+            holder.items.erase(std::remove_if(holder.items.begin(), holder.items.end(),
+                                              [](const std::shared_ptr<Staging> &s)
+                                              { return s->detached.load(); }),
+                               holder.items.end());
+            std::shared_ptr<Staging> s;
+            {
+                // 与Stop()在同一把锁下检查，停止后注册的暂存缓冲区不会被清理，线程退出时将访问已销毁的工作器
+                std::unique_lock<std::mutex> lock(staging_mutex_);
+                if (staging_stopped_)
+                {
+                    return nullptr;
+                }
+                s = std::make_shared<Staging>(this);
+                stagings_.push_back(s);
+            }
+            holder.items.push_back(s);
+            return s.get();
+        }
+
+        void Unregister(Staging *s)
+        {
+            std::unique_lock<std::mutex> lock(staging_mutex_);
+            stagings_.erase(std::remove_if(stagings_.begin(), stagings_.end(),
+                                           [s](const std::shared_ptr<Staging> &e)
+                                           { return e.get() == s; }),
+                            stagings_.end());
+        }
+
+        // 暂存缓冲区还能放入的字节数，调用方需持有s->mutex
+        size_t Room(Staging &s)
+        {
+            size_t used = s.buffer.ReadableSize();
+            return used >= staging_limit_ ? 0 : std::min(s.buffer.WriteableSize(), staging_limit_ - used);
+        }
+
+        // 调用方需持有s->mutex，urgent表示最后一条是ERROR/FATAL日志
+        void HandOff(Staging &s, bool urgent = false)
+        {
+            if (!s.buffer.IsEmpty())
+            {
+                Push(s.buffer.Begin(), s.buffer.ReadableSize(), s.records, urgent);
+                s.buffer.Reset();
+                s.records = 0;
+            }
+        }
+
+        // 提交所有暂存数据，detach为真时同时解除暂存(用于停止)
+        void DrainStaging(bool detach)
+        {
+            std::vector<std::shared_ptr<Staging>> stagings;
+            {
+                std::unique_lock<std::mutex> lock(staging_mutex_);
+                stagings = stagings_;
+                if (detach)
+                {
+                    stagings_.clear();
+                    staging_stopped_ = true;
+                }
+            }
+            for (auto &s : stagings)
+            {
+                std::unique_lock<std::mutex> lock(s->mutex);
+                if (s->detached)
+                {
+                    continue;
+                }
+                HandOff(*s);
+                if (detach)
+                {
+                    s->detached = true;
+                }
+            }
+        }
+
+        // 消费者线程定期清扫超时的暂存数据，不能阻塞，拿不到锁或空间不足时留到下一轮
+        void SweepStaging()
+        {
+            if (g_conf_data->staging_size == 0 || staging_interval_.count() == 0)
+            {
+                return;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_sweep_ < staging_interval_ / 2)
+            {
+                return;
+            }
+            last_sweep_ = now;
+            std::vector<std::shared_ptr<Staging>> stagings;
+            {
+                std::unique_lock<std::mutex> lock(staging_mutex_);
+                stagings = stagings_;
+            }
+            for (auto &s : stagings)
+            {
+                std::unique_lock<std::mutex> lock(s->mutex, std::try_to_lock);
+                if (!lock.owns_lock() || s->detached || s->buffer.IsEmpty() || now - s->first < staging_interval_)
+                {
+                    continue;
+                }
+                if (TryPush(s->buffer.Begin(), s->buffer.ReadableSize(), s->records))
+                {
+                    s->buffer.Reset();
+                    s->records = 0;
+                }
+            }
+        }
+
+        // 非阻塞写入共享缓冲区，供消费者线程自身使用，空间不足时返回false，数据留在暂存缓冲区
+        bool TryPush(const char *data, size_t len, size_t records)
+        {
+            if (ring_)
+            {
+                return ring_->TryPush(data, len);
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            bool full = overflow_.policy == OverflowPolicy::DEFAULT
+                            ? AsyncType::ASYNC_SAFE == async_type_ && len > buffer_producer_.WriteableSize()
+                            : !Fits(len);
+            if (full)
+            {
+                return false;
+            }
+            Append(data, len, records, false);
+            return true;
+        }
+
+        // 共享缓冲区的数据量，用于在格式化前判断是否丢弃
+        size_t Fill()
+        {
+            return ring_ ? ring_->WritePos() - ring_->ReadPos() : fill_.load(std::memory_order_relaxed);
+        }
+
+        // 在格式化之前按溢出策略决定是否接收一条日志，ERROR/FATAL总是接收
+        bool Admit(bool urgent)
+        {
+            if (urgent || (overflow_.policy != OverflowPolicy::DROP_NEWEST && overflow_.policy != OverflowPolicy::SAMPLE))
+            {
+                return true;
+            }
+            size_t fill = Fill();
+            if (fill >= capacity_)
+            {
+                Dropped(0, 1);
+                return false;
+            }
+            if (overflow_.policy == OverflowPolicy::SAMPLE && fill >= overflow_.watermark * capacity_ &&
+                Random() >= overflow_.sample_rate)
+            {
+                overflow_stats_.sampled.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            return true;
+        }
+
+        // [0, 1)之间的伪随机数，每个线程独立
+        static double Random()
+        {
+            static thread_local uint64_t x = 0x9E3779B97F4A7C15ULL ^ reinterpret_cast<uintptr_t>(&x);
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            return (x >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        void Dropped(size_t len, size_t records)
+        {
+            overflow_stats_.dropped.fetch_add(records, std::memory_order_relaxed);
+            overflow_stats_.dropped_bytes.fetch_add(len, std::memory_order_relaxed);
+        }
+
+        // 生产者缓冲区在容量内能否再放入len字节，调用方需持有mutex_
+        bool Fits(size_t len)
+        {
+            return buffer_producer_.IsEmpty() || buffer_producer_.ReadableSize() + len <= capacity_;
+        }
+
+        // 按溢出策略为len字节腾出空间，返回false表示丢弃，调用方需持有mutex_
+        bool MakeRoom(std::unique_lock<std::mutex> &lock, size_t len, size_t records, bool urgent)
+        {
+            switch (overflow_.policy)
+            {
+            case OverflowPolicy::DEFAULT:
+                if (AsyncType::ASYNC_SAFE == async_type_)
+                {
+                    // 如果是线程安全模式，等待缓冲区有足够的可写空间
+                    cv_producer_.wait(lock, [this, len]()
+                                      { return len <= this->buffer_producer_.WriteableSize(); });
+                }
+                return true;
+            case OverflowPolicy::BLOCK:
+                if (!Fits(len))
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    bool ok = cv_producer_.wait_for(lock, overflow_.timeout, [this, len]()
+                                                    { return Fits(len); });
+                    overflow_stats_.delayed.fetch_add(records, std::memory_order_relaxed);
+                    overflow_stats_.delayed_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                             std::chrono::steady_clock::now() - start)
+                                                             .count(),
+                                                         std::memory_order_relaxed);
+                    if (!ok && !urgent)
+                    {
+                        Dropped(len, records);
+                        return false;
+                    }
+                }
+                return true;
+            case OverflowPolicy::DROP_OLDEST:
+                if (!Fits(len))
+                {
+                    EvictOldest(len);
+                }
+                break;
+            default:
+                break;
+            }
+            if (Fits(len) || urgent)
+            {
+                return true;
+            }
+            Dropped(len, records);
+            return false;
+        }
+
+        // 写入生产者缓冲区，调用方需持有mutex_
+        void Append(const char *data, size_t len, size_t records, bool urgent)
+        {
+            buffer_producer_.Push(data, len);
+            if (overflow_.policy == OverflowPolicy::DROP_OLDEST)
+            {
+                chunks_.push_back(Chunk{len, records, urgent});
+            }
+            fill_.store(buffer_producer_.ReadableSize(), std::memory_order_relaxed);
+        }
+
+        // 丢弃生产者缓冲区中最早的数据块，直到数据量降到容量的一半(或刚好放得下len)，一次性搬移剩余数据以分摊开销
+        // 含ERROR/FATAL日志的数据块整体保留，调用方需持有mutex_
+        void EvictOldest(size_t len)
+        {
+            size_t keep = len >= capacity_ ? 0 : std::min(capacity_ / 2, capacity_ - len);
+            size_t fill = buffer_producer_.ReadableSize();
+            char *base = buffer_producer_.ReadBegin(fill);
+            size_t src = 0, dst = 0, n = 0;
+            for (auto &c : chunks_)
+            {
+                if (fill > keep && !c.urgent)
+                {
+                    fill -= c.len;
+                    Dropped(c.len, c.records);
+                }
+                else
+                {
+                    memmove(base + dst, base + src, c.len);
+                    dst += c.len;
+                    chunks_[n++] = c;
+                }
+                src += c.len;
+            }
+            chunks_.resize(n);
+            buffer_producer_.Truncate(dst);
+            fill_.store(dst, std::memory_order_relaxed);
+        }
+
+        // 无锁模式下写入环形缓冲区，仅在消费者休眠时加锁唤醒
+        // 超过单条记录上限的数据在行尾处拆成多段依次写入，单行本身超过上限时按上限拆分(各段之间可能夹有其他线程的日志)
+        // 二进制记录拆开后无法解码，超过上限时整条丢弃并计入dropped
+        void PushLockFree(const char *data, size_t len, size_t records, bool urgent)
+        {
+            size_t max = ring_->MaxRecordSize();
+            if (binary_ && len > max)
+            {
+                Dropped(len, records);
+                return;
+            }
+            while (len > max)
+            {
+                const char *nl = static_cast<const char *>(memrchr(data, '\n', max));
+                size_t n = nl ? nl - data + 1 : max;
+                size_t lines = 0;
+                for (const char *p = data; (p = static_cast<const char *>(memchr(p, '\n', data + n - p))) != nullptr; ++p)
+                {
+                    ++lines;
+                }
+                lines = std::min(lines, records);
+                PushRecord(data, n, lines, urgent);
+                data += n;
+                len -= n;
+                records -= lines;
+            }
+            PushRecord(data, len, std::max<size_t>(records, 1), urgent);
+        }
+
+        // 把不超过单条记录上限的数据写入环形缓冲区
+        void PushRecord(const char *data, size_t len, size_t records, bool urgent)
+        {
+            if (overflow_.policy == OverflowPolicy::DEFAULT || urgent)
+            {
+                ring_->Push(data, len);
+            }
+            else if (!ring_->TryPush(data, len))
+            {
+                bool ok = false;
+                if (overflow_.policy == OverflowPolicy::BLOCK)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    auto deadline = start + overflow_.timeout;
+                    while (!(ok = ring_->TryPush(data, len)) && std::chrono::steady_clock::now() < deadline)
+                    {
+                        std::this_thread::yield();
+                    }
+                    overflow_stats_.delayed.fetch_add(records, std::memory_order_relaxed);
+                    overflow_stats_.delayed_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                             std::chrono::steady_clock::now() - start)
+                                                             .count(),
+                                                         std::memory_order_relaxed);
+                }
+                if (!ok)
+                {
+                    Dropped(len, records);
+                    return;
+                }
+            }
+            if (sleeping_.load(std::memory_order_seq_cst))
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_consumer_.notify_one();
+            }
+        }
+
+        // 无锁模式的消费者循环
+        // 落盘请求只有在请求发出时已预留的数据全部消费后才能完成
+        void LockFreeEntry()
+        {
+            uint64_t sync_request = 0, sync_pos = 0;
+            while (true)
+            {
+                SweepStaging();
+                uint64_t req = sync_requested_.load(std::memory_order_seq_cst);
+                if (req > sync_request)
+                {
+                    sync_request = req;
+                    sync_pos = ring_->WritePos(); // 先读请求再读写位置，请求之前的写入都在该位置之前
+                }
+                if (!ring_->HasCommitted())
+                {
+                    Synced(ring_->ReadPos() >= sync_pos ? sync_request : sync_done_.load());
+                    if (stop_ && ring_->IsEmpty())
+                        return; // 停止且所有已预留的数据都已消费，退出线程
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    sleeping_.store(true, std::memory_order_seq_cst);
+                    if (!ring_->HasCommitted() && !stop_ && !SyncPending())
+                    {
+                        cv_consumer_.wait_for(lock, tick_.count() != 0 ? std::min(tick_, kLockFreeTick) : kLockFreeTick);
+                    }
+                    sleeping_.store(false, std::memory_order_relaxed);
+                    continue;
+                }
+                ring_->Drain(buffer_consumer_, g_conf_data->buffer_size);
+                callback_(buffer_consumer_); // 调用回调函数处理消费者缓冲区数据
+                buffer_consumer_.Reset();
+                buffer_consumer_.Shrink();   // 突发写入扩容的内存还给内存池
+                Synced(ring_->ReadPos() >= sync_pos ? sync_request : sync_done_.load());
+            }
+        }
+
+        // 是否有未完成的落盘请求
+        bool SyncPending()
+        {
+            return sync_requested_.load() > sync_done_.load();
+        }
+
+        // 处理完一批数据后调用：request之前的落盘请求都已可以完成时强制落盘并唤醒等待者，否则按策略检查
+        void Synced(uint64_t request)
+        {
+            bool force = request > sync_done_.load();
+            if (on_sync_)
+            {
+                on_sync_(force);
+            }
+            if (force)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(sync_mutex_);
+                    sync_done_.store(request);
+                }
+                sync_cv_.notify_all();
+            }
+        }
+
         // 消费者线程入口函数
         void ThreadEntry()
         {
+            PinThread(pthread_self(), cpus_);
+            if (ring_)
+            {
+                LockFreeEntry();
+            }
+            else
+            {
+                MutexEntry();
+            }
+            Synced(sync_requested_.load()); // 所有数据都已处理，完成剩余的落盘请求
+            if (on_exit_)
+            {
+                on_exit_();
+            }
+        }
+
+        // 加锁模式的消费者循环
+        void MutexEntry()
+        {
+            auto ready = [&]()
+            { return stop_ || !buffer_producer_.IsEmpty() || SyncPending(); };
             while (true)
             {
+                SweepStaging();
+                uint64_t sync_request;
                 {
                     std::unique_lock<std::mutex> lock(mutex_);
-                    // 如果生产者缓冲区为空且停止标志为真，等待条件变量
-                    if (buffer_producer_.IsEmpty() && stop_)
+                    // 生产者缓冲区为空时等待，直到有数据、落盘请求或停止；启用暂存或组提交时定时醒来
+                    if (tick_.count() != 0)
+                    {
+                        cv_consumer_.wait_for(lock, tick_, ready);
+                    }
+                    else
                     {
-                        cv_consumer_.wait(lock, [&]()
-                                          { return stop_ || !buffer_consumer_.IsEmpty(); });
+                        cv_consumer_.wait(lock, ready);
                     }
-                    buffer_producer_.Swap(buffer_consumer_); // 交换生产者和消费者缓冲区
-                    if (async_type_ == AsyncType::ASYNC_SAFE)
+                    // 请求先于加锁前的写入之后发出，这些写入必然在本次交换的缓冲区中
+                    sync_request = sync_requested_.load();
+                    if (stop_ && buffer_producer_.IsEmpty())
+                        return; // 如果停止标志为真且生产者缓冲区为空，退出线程
+                    if (!buffer_producer_.IsEmpty())
                     {
-                        cv_producer_.notify_one(); // 通知生产者线程
+                        buffer_producer_.Swap(buffer_consumer_); // 交换生产者和消费者缓冲区
+                        chunks_.clear();
+                        fill_.store(0, std::memory_order_relaxed);
+                        cv_producer_.notify_all(); // 通知等待空间的生产者线程
                     }
                 }
-                callback_(buffer_consumer_); // 调用回调函数处理消费者缓冲区数据
-                buffer_consumer_.Reset();   // 重置消费者缓冲区
-                if (stop_ && buffer_producer_.IsEmpty())
-                    return; // 如果停止标志为真且生产者缓冲区为空，退出线程
+                if (!buffer_consumer_.IsEmpty())
+                {
+                    callback_(buffer_consumer_); // 调用回调函数处理消费者缓冲区数据
+                    buffer_consumer_.Reset();   // 重置消费者缓冲区
+                    buffer_consumer_.Shrink();  // 突发写入扩容的内存还给内存池
+                }
+                Synced(sync_request);
             }
         }
 
     private:
+        // 生产者缓冲区中一次写入的数据块，供DROP_OLDEST按块丢弃
+        struct Chunk
+        {
+            size_t len;     // 字节数
+            size_t records; // 日志条数
+            bool urgent;    // 是否含ERROR/FATAL日志
+        };
+
         AsyncType async_type_;            // 异步类型
+        bool binary_;                     // 数据是否为二进制记录
         std::atomic<bool> stop_;          // 停止标志
+        OverflowOptions overflow_;        // 溢出策略
+        OverflowStats overflow_stats_;    // 溢出统计
+        size_t capacity_;                 // 共享缓冲区容量
+        std::atomic<size_t> fill_{0};     // 生产者缓冲区的数据量(加锁模式)
+        std::vector<Chunk> chunks_;       // 生产者缓冲区中的数据块(仅DROP_OLDEST)
         std::mutex mutex_;                // 互斥锁
         mylog::Buffer buffer_producer_;   // 生产者缓冲区
         mylog::Buffer buffer_consumer_;   // 消费者缓冲区
         std::condition_variable cv_producer_; // 生产者条件变量
         std::condition_variable cv_consumer_; // 消费者条件变量
-        std::thread thread_;              // 消费者线程
+        std::unique_ptr<RingBuffer> ring_;    // 无锁模式下的环形缓冲区
+        std::atomic<bool> sleeping_{false};   // 无锁模式下消费者是否休眠
+        std::mutex staging_mutex_;            // 保护stagings_
+        std::vector<std::shared_ptr<Staging>> stagings_; // 各生产者线程的暂存缓冲区
+        bool staging_stopped_ = false;                   // 已停止，不再注册暂存缓冲区(受staging_mutex_保护)
+        size_t staging_limit_;                           // 每个暂存缓冲区一批最多的数据量
+        std::chrono::milliseconds staging_interval_;     // 暂存数据最长停留时间
+        std::chrono::steady_clock::time_point last_sweep_; // 上次清扫时间(仅消费者线程访问)
         functor callback_;                // 回调函数
+        std::function<void()> on_exit_;   // 消费者线程退出前的回调
+        std::function<void(bool)> on_sync_; // 落盘回调
+        std::vector<int> cpus_;             // 消费者线程绑定的CPU，为空时不绑定
+        std::chrono::milliseconds tick_{0}; // 消费者定时醒来的间隔，0表示只在有数据时醒来
+        std::atomic<uint64_t> sync_requested_{0}; // 已发出的落盘请求数
+        std::atomic<uint64_t> sync_done_{0};      // 已完成的落盘请求数
+        std::mutex sync_mutex_;                   // 配合sync_cv_等待落盘完成
+        std::condition_variable sync_cv_;
+        std::thread thread_;              // 消费者线程，最后初始化
     };
 }
\ No newline at end of file
@@ -0,0 +1,430 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LogFlush.hpp"
+
+namespace mylog
+{
+    // 远程备份的选项
+    struct BackupOptions
+    {
+        std::string addr;                                 // 备份服务器地址(IP或主机名)
+        uint16_t port = 0;                                // 备份服务器端口
+        std::string name;                                 // 实例名(如日志器名)，用于区分发往同一服务器的多个实例
+        // 服务器不可达时暂存数据的本地文件，下次连上后先补发；为空时取./logfile/backup-<addr>-<port>[-<name>].spool
+        // 暂存文件只能由一个实例使用(flock)，已被其他实例或进程占用时不暂存，不可达期间的数据计入dropped_bytes
+        std::string spool_path;
+        size_t batch_bytes = 64 * 1024;                   // 攒够该字节数立即发送
+        std::chrono::milliseconds batch_interval{100};    // 最长攒批时间
+        size_t max_pending = 4 * 1024 * 1024;             // 内存中待发送数据的上限，超出时丢弃新数据
+        size_t max_spool = 256 * 1024 * 1024;             // 暂存文件的上限，超出时丢弃新数据
+        std::chrono::milliseconds backoff_min{100};       // 重连的初始间隔
+        std::chrono::milliseconds backoff_max{30000};     // 重连间隔的上限，每次失败翻倍
+        std::chrono::milliseconds io_timeout{1000};       // 连接和发送的超时
+
+        // 配置文件中的备份服务器
+        static BackupOptions FromConfig()
+        {
+            BackupOptions options;
+            options.addr = g_conf_data->backup_addr;
+            options.port = g_conf_data->backup_port;
+            return options;
+        }
+    };
+
+    // 远程备份统计
+    struct BackupStats
+    {
+        std::atomic<uint64_t> sent_bytes{0};     // 发送到服务器的字节数(含补发)
+        std::atomic<uint64_t> batches{0};        // 发送的批次数
+        std::atomic<uint64_t> spooled_bytes{0};  // 写入暂存文件的字节数
+        std::atomic<uint64_t> replayed_bytes{0}; // 从暂存文件补发的字节数
+        std::atomic<uint64_t> dropped_bytes{0};  // 内存或暂存文件超过上限而丢弃的字节数
+        std::atomic<uint64_t> connects{0};       // 成功建立连接的次数
+        std::atomic<uint64_t> failures{0};       // 连接或发送失败的次数
+    };
+
+    // 将日志通过TCP发送到远程备份服务器：生产者只把数据追加到内存批次，从不等待网络；
+    // 发送线程按批次发送并保持长连接，断线后按指数退避重连，不可达期间数据写入本地暂存文件，连上后按原顺序先补发
+    // 没有应用层确认：断线时已交给内核的部分不再重发，服务器崩溃时其未读取的数据会丢失；
+    // 暂存文件中的数据在补发完成前进程退出的，下次启动后从头补发(至少一次)
+    class BackupFlush : public LogFlush
+    {
+    public:
+        using ptr = std::shared_ptr<BackupFlush>;
+        explicit BackupFlush(const BackupOptions &options)
+            : options_(options), backoff_(options.backoff_min)
+        {
+            OpenSpool();
+            thread_ = std::thread(&BackupFlush::ThreadEntry, this);
+        }
+
+        BackupFlush(const std::string &addr, uint16_t port)
+            : BackupFlush(WithServer(addr, port)) {}
+
+        ~BackupFlush()
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            thread_.join(); // 发送或暂存剩余的数据后退出
+            Disconnect(false);
+            if (spool_fd_ >= 0)
+            {
+                close(spool_fd_);
+            }
+        }
+
+        // 作为普通输出方式时备份全部日志
+        void Flush(const char *data, size_t len) override
+        {
+            Send(data, len);
+        }
+
+        // 追加待发送的数据，不做任何IO；内存中的数据超过上限时丢弃
+        void Send(const char *data, size_t len)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (pending_.size() + len > options_.max_pending)
+            {
+                stats_.dropped_bytes.fetch_add(len, std::memory_order_relaxed);
+                return;
+            }
+            pending_.append(data, len);
+            if (pending_.size() >= options_.batch_bytes)
+            {
+                cv_.notify_one();
+            }
+        }
+
+        // 等待此前追加的数据发出或写入暂存文件
+        void Wait() override
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (stop_)
+            {
+                return;
+            }
+            uint64_t target = ++requested_;
+            cv_.notify_one();
+            cv_idle_.wait(lock, [this, target]()
+                          { return handled_ >= target; });
+        }
+
+        const BackupStats &Stats() const { return stats_; }
+
+    private:
+        static BackupOptions WithServer(const std::string &addr, uint16_t port)
+        {
+            BackupOptions options;
+            options.addr = addr;
+            options.port = port;
+            return options;
+        }
+
+        // 发送线程：攒批后发送，没有新数据时也按退避间隔尝试重连以补发暂存文件
+        void ThreadEntry()
+        {
+            std::string batch;
+            while (true)
+            {
+                bool stop;
+                uint64_t requested;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait_for(lock, options_.batch_interval, [this]()
+                                 { return stop_ || requested_ > handled_ || pending_.size() >= options_.batch_bytes; });
+                    batch.swap(pending_);
+                    stop = stop_;
+                    requested = requested_;
+                }
+                Deliver(batch);
+                batch.clear();
+                if (batch.capacity() > options_.batch_bytes * 4)
+                {
+                    batch.shrink_to_fit(); // 突发之后不长期占用内存
+                }
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    handled_ = requested;
+                }
+                cv_idle_.notify_all();
+                if (stop)
+                {
+                    break;
+                }
+            }
+        }
+
+        // 连接可用时先补发暂存文件再发送本批，否则本批(或未发出的部分)追加到暂存文件，保持原有顺序
+        void Deliver(const std::string &batch)
+        {
+            if (sock_ >= 0 && PeerClosed())
+            {
+                Disconnect(true); // 对端已关闭，发送仍会成功但数据会丢失
+            }
+            if (sock_ < 0 && std::chrono::steady_clock::now() >= retry_at_ && (!batch.empty() || spool_size_ > spool_offset_))
+            {
+                Connect();
+            }
+            size_t sent = 0;
+            if (sock_ >= 0 && ReplaySpool())
+            {
+                if (batch.empty())
+                {
+                    return;
+                }
+                sent = SendAll(batch.data(), batch.size());
+                if (sent == batch.size())
+                {
+                    stats_.batches.fetch_add(1, std::memory_order_relaxed);
+                    backoff_ = options_.backoff_min; // 发送成功后才重置退避，避免连上即断的服务器导致频繁重连
+                    return;
+                }
+            }
+            if (sent < batch.size())
+            {
+                Spool(batch.data() + sent, batch.size() - sent);
+            }
+        }
+
+        // 建立连接，失败时按退避间隔安排下次重连
+        bool Connect()
+        {
+            struct addrinfo hints;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            struct addrinfo *res = nullptr;
+            std::string port = std::to_string(options_.port);
+            if (getaddrinfo(options_.addr.c_str(), port.c_str(), &hints, &res) != 0)
+            {
+                std::cout << __FILE__ << __LINE__ << "resolve backup server " << options_.addr << " failed" << std::endl;
+                Disconnect(true);
+                return false;
+            }
+            for (struct addrinfo *ai = res; ai != nullptr && sock_ < 0; ai = ai->ai_next)
+            {
+                int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+                if (fd < 0)
+                {
+                    continue;
+                }
+                if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0 &&
+                    (errno != EINPROGRESS || !WaitWritable(fd) || SocketError(fd) != 0))
+                {
+                    close(fd);
+                    continue;
+                }
+                sock_ = fd;
+            }
+            freeaddrinfo(res);
+            if (sock_ < 0)
+            {
+                Disconnect(true);
+                return false;
+            }
+            stats_.connects.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // 关闭连接，failed为true时记一次失败并推迟下次重连
+        void Disconnect(bool failed)
+        {
+            if (sock_ >= 0)
+            {
+                close(sock_);
+                sock_ = -1;
+            }
+            if (failed)
+            {
+                stats_.failures.fetch_add(1, std::memory_order_relaxed);
+                retry_at_ = std::chrono::steady_clock::now() + backoff_;
+                backoff_ = std::min(backoff_ * 2, options_.backoff_max);
+            }
+        }
+
+        bool WaitWritable(int fd)
+        {
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            int ret;
+            do
+            {
+                ret = poll(&pfd, 1, static_cast<int>(options_.io_timeout.count()));
+            } while (ret < 0 && errno == EINTR);
+            return ret > 0;
+        }
+
+        // 对端是否已关闭或重置连接(备份服务器不会向客户端发送数据)
+        bool PeerClosed()
+        {
+            char c;
+            ssize_t n = recv(sock_, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+            return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+        }
+
+        static int SocketError(int fd)
+        {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0)
+            {
+                return errno;
+            }
+            return err;
+        }
+
+        // 发送len字节，返回实际发出的字节数；出错或超时时断开连接
+        size_t SendAll(const char *data, size_t len)
+        {
+            size_t sent = 0;
+            while (sent < len)
+            {
+                ssize_t n = send(sock_, data + sent, len - sent, MSG_NOSIGNAL);
+                if (n > 0)
+                {
+                    sent += n;
+                    continue;
+                }
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && WaitWritable(sock_))
+                {
+                    continue;
+                }
+                Disconnect(true);
+                break;
+            }
+            stats_.sent_bytes.fetch_add(sent, std::memory_order_relaxed);
+            return sent;
+        }
+
+        // 打开并独占暂存文件，上次进程遗留的数据会在连上后补发
+        void OpenSpool()
+        {
+            if (options_.spool_path.empty())
+            {
+                options_.spool_path = "./logfile/backup-" + options_.addr + "-" + std::to_string(options_.port) +
+                                      (options_.name.empty() ? "" : "-" + options_.name) + ".spool";
+            }
+            Util::File::CreateDirectory(Util::File::Path(options_.spool_path));
+            spool_fd_ = open(options_.spool_path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (spool_fd_ < 0)
+            {
+                std::cout << __FILE__ << __LINE__ << "open spool file " << options_.spool_path << " failed" << std::endl;
+                perror(NULL);
+                return;
+            }
+            // 共用暂存文件的实例会互相截断或重复补发对方的数据
+            if (flock(spool_fd_, LOCK_EX | LOCK_NB) != 0)
+            {
+                std::cout << __FILE__ << __LINE__ << "spool file " << options_.spool_path << " is used by another backup" << std::endl;
+                perror(NULL);
+                close(spool_fd_);
+                spool_fd_ = -1;
+                return;
+            }
+            struct stat st;
+            if (fstat(spool_fd_, &st) == 0)
+            {
+                spool_size_ = st.st_size;
+            }
+        }
+
+        void Spool(const char *data, size_t len)
+        {
+            if (spool_fd_ < 0 || spool_size_ - spool_offset_ + len > options_.max_spool)
+            {
+                stats_.dropped_bytes.fetch_add(len, std::memory_order_relaxed);
+                return;
+            }
+            size_t written = 0;
+            while (written < len)
+            {
+                ssize_t n = write(spool_fd_, data + written, len - written);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    std::cout << __FILE__ << __LINE__ << "write spool file " << options_.spool_path << " failed" << std::endl;
+                    perror(NULL);
+                    stats_.dropped_bytes.fetch_add(len - written, std::memory_order_relaxed);
+                    break;
+                }
+                written += n;
+            }
+            spool_size_ += written;
+            stats_.spooled_bytes.fetch_add(written, std::memory_order_relaxed);
+        }
+
+        // 补发暂存文件，全部发出后清空文件；中途断线时记住位置，下次从该位置继续
+        bool ReplaySpool()
+        {
+            char buf[64 * 1024];
+            while (spool_offset_ < spool_size_)
+            {
+                ssize_t n = pread(spool_fd_, buf, std::min(sizeof(buf), spool_size_ - spool_offset_), spool_offset_);
+                if (n <= 0)
+                {
+                    std::cout << __FILE__ << __LINE__ << "read spool file " << options_.spool_path << " failed" << std::endl;
+                    perror(NULL);
+                    break; // 无法读取的部分放弃
+                }
+                size_t sent = SendAll(buf, n);
+                spool_offset_ += sent;
+                stats_.replayed_bytes.fetch_add(sent, std::memory_order_relaxed);
+                if (sent < static_cast<size_t>(n))
+                {
+                    return false;
+                }
+            }
+            if (spool_size_ != 0 && ftruncate(spool_fd_, 0) == 0)
+            {
+                spool_size_ = 0;
+                spool_offset_ = 0;
+            }
+            return sock_ >= 0;
+        }
+
+    private:
+        BackupOptions options_;
+        std::mutex mutex_;
+        std::condition_variable cv_;      // 通知发送线程
+        std::condition_variable cv_idle_; // 通知Wait的调用者
+        std::string pending_;             // 待发送的数据
+        uint64_t requested_ = 0;          // Wait请求的编号
+        uint64_t handled_ = 0;            // 已处理完的Wait请求
+        bool stop_ = false;               // 停止标志
+        // 以下只在发送线程中访问
+        int sock_ = -1;                   // 与服务器的连接
+        std::chrono::milliseconds backoff_; // 当前重连间隔
+        std::chrono::steady_clock::time_point retry_at_; // 下次允许重连的时间
+        int spool_fd_ = -1;               // 暂存文件
+        size_t spool_size_ = 0;           // 暂存文件大小
+        size_t spool_offset_ = 0;         // 已补发到的位置
+        BackupStats stats_;               // 发送统计
+        std::thread thread_;              // 发送线程，最后初始化
+    };
+}
@@ -0,0 +1,426 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "BinaryLog.hpp"
+
+namespace mylog
+{
+    // 紧凑的二进制日志文件格式
+    // 文件以8字节魔数"MYLOGBIN"和1字节版本号开头，之后是一系列条目，每个条目以1字节类型开头:
+    //   RESET  : 清空字典和时间基准(每次打开文件时写入，调用点编号在不同进程间不通用)
+    //   SITE   : varint编号 | u8级别 | varint行号 | 字符串文件名 | 字符串格式串
+    //   LOGGER : varint编号 | 字符串日志器名
+    //   THREAD : varint编号 | varint线程ID
+    //   RECORD : varint调用点 | varint日志器 | varint线程 | zigzag时间差(纳秒) | varint参数个数 | 参数...
+    //   TEXT   : 字符串(已格式化的文本，原样输出)
+    // 字符串为varint长度+内容；参数为u8类型标签 + 值: INT为zigzag varint，UINT/POINTER为varint，
+    // DOUBLE为8字节，BOOL/CHAR为1字节，STRING为字符串
+    namespace binfile
+    {
+        constexpr char kMagic[8] = {'M', 'Y', 'L', 'O', 'G', 'B', 'I', 'N'};
+        constexpr uint8_t kVersion = 1;
+
+        enum EntryType : uint8_t
+        {
+            RESET = 0,
+            SITE = 1,
+            LOGGER = 2,
+            THREAD = 3,
+            RECORD = 4,
+            TEXT = 5
+        };
+
+        inline uint64_t ZigZag(int64_t v)
+        {
+            return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+        }
+
+        inline int64_t UnZigZag(uint64_t v)
+        {
+            return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+        }
+
+        inline void PutVarint(std::string &out, uint64_t v)
+        {
+            while (v >= 0x80)
+            {
+                out.push_back(static_cast<char>(v | 0x80));
+                v >>= 7;
+            }
+            out.push_back(static_cast<char>(v));
+        }
+
+        inline void PutString(std::string &out, std::string_view s)
+        {
+            PutVarint(out, s.size());
+            out.append(s.data(), s.size());
+        }
+
+        // 顺序读取，越界时返回false
+        class Reader
+        {
+        public:
+            Reader(const char *data, size_t len) : p_(data), end_(data + len) {}
+
+            bool Eof() const { return p_ >= end_; }
+
+            const char *Pos() const { return p_; }
+
+            bool GetByte(uint8_t &v)
+            {
+                if (p_ >= end_)
+                    return false;
+                v = static_cast<uint8_t>(*p_++);
+                return true;
+            }
+
+            bool GetBytes(void *dst, size_t n)
+            {
+                if (static_cast<size_t>(end_ - p_) < n)
+                    return false;
+                memcpy(dst, p_, n);
+                p_ += n;
+                return true;
+            }
+
+            bool GetVarint(uint64_t &v)
+            {
+                v = 0;
+                for (int shift = 0; shift < 64 && p_ < end_; shift += 7)
+                {
+                    uint8_t b = static_cast<uint8_t>(*p_++);
+                    v |= static_cast<uint64_t>(b & 0x7f) << shift;
+                    if (!(b & 0x80))
+                        return true;
+                }
+                return false;
+            }
+
+            bool GetString(std::string_view &s)
+            {
+                uint64_t n;
+                if (!GetVarint(n) || static_cast<uint64_t>(end_ - p_) < n)
+                    return false;
+                s = std::string_view(p_, n);
+                p_ += n;
+                return true;
+            }
+
+        private:
+            const char *p_;
+            const char *end_;
+        };
+
+        // 写入端：维护当前文件中已定义的调用点、日志器和线程
+        class Encoder
+        {
+        public:
+            // 开始新的会话(新文件或重新打开文件时调用)
+            void Reset(std::string &out)
+            {
+                sites_.clear();
+                loggers_.clear();
+                threads_.clear();
+                last_ts_ = 0;
+                last_tid_ = 0;
+                last_thread_ = UINT32_MAX;
+                out.push_back(static_cast<char>(RESET));
+            }
+
+            void EncodeText(std::string &out, std::string_view text)
+            {
+                out.push_back(static_cast<char>(TEXT));
+                PutString(out, text);
+            }
+
+            void EncodeRecord(std::string &out, std::string_view logger, const BinaryRecord::View &view)
+            {
+                if (view.site == 0)
+                {
+                    if (view.nargs == 1 && view.args[0].type == fmt::ArgType::STRING)
+                    {
+                        EncodeText(out, view.args[0].s);
+                    }
+                    return;
+                }
+                if (!DefineSite(out, view.site))
+                {
+                    return;
+                }
+                uint32_t logger_id = DefineLogger(out, logger);
+                uint32_t thread_id = DefineThread(out, view.tid);
+                out.push_back(static_cast<char>(RECORD));
+                PutVarint(out, view.site);
+                PutVarint(out, logger_id);
+                PutVarint(out, thread_id);
+                PutVarint(out, ZigZag(view.ts - last_ts_));
+                last_ts_ = view.ts;
+                PutVarint(out, view.nargs);
+                for (size_t i = 0; i < view.nargs; ++i)
+                {
+                    const fmt::ArgValue &v = view.args[i];
+                    out.push_back(static_cast<char>(v.type));
+                    switch (v.type)
+                    {
+                    case fmt::ArgType::BOOL:
+                        out.push_back(static_cast<char>(v.b));
+                        break;
+                    case fmt::ArgType::CHAR:
+                        out.push_back(v.c);
+                        break;
+                    case fmt::ArgType::INT:
+                        PutVarint(out, ZigZag(v.i));
+                        break;
+                    case fmt::ArgType::UINT:
+                    case fmt::ArgType::POINTER:
+                        PutVarint(out, v.u);
+                        break;
+                    case fmt::ArgType::DOUBLE:
+                        out.append(reinterpret_cast<const char *>(&v.d), sizeof(v.d));
+                        break;
+                    case fmt::ArgType::STRING:
+                        PutString(out, v.s);
+                        break;
+                    }
+                }
+            }
+
+        private:
+            bool DefineSite(std::string &out, uint32_t id)
+            {
+                if (id < sites_.size() && sites_[id])
+                {
+                    return true;
+                }
+                const CallSite *site = CallSiteRegistry::GetInstance().Get(id);
+                if (site == nullptr)
+                {
+                    return false;
+                }
+                if (id >= sites_.size())
+                {
+                    sites_.resize(id + 1, false);
+                }
+                sites_[id] = true;
+                out.push_back(static_cast<char>(SITE));
+                PutVarint(out, id);
+                out.push_back(static_cast<char>(site->level_));
+                PutVarint(out, site->line_);
+                PutString(out, site->file_);
+                PutString(out, site->format_);
+                return true;
+            }
+
+            uint32_t DefineLogger(std::string &out, std::string_view name)
+            {
+                if (last_logger_ < loggers_.size() && loggers_[last_logger_] == name)
+                {
+                    return last_logger_;
+                }
+                for (uint32_t i = 0; i < loggers_.size(); ++i)
+                {
+                    if (loggers_[i] == name)
+                    {
+                        return last_logger_ = i;
+                    }
+                }
+                loggers_.emplace_back(name);
+                last_logger_ = loggers_.size() - 1;
+                out.push_back(static_cast<char>(LOGGER));
+                PutVarint(out, last_logger_);
+                PutString(out, name);
+                return last_logger_;
+            }
+
+            uint32_t DefineThread(std::string &out, uint64_t tid)
+            {
+                if (last_thread_ != UINT32_MAX && tid == last_tid_)
+                {
+                    return last_thread_;
+                }
+                auto it = threads_.find(tid);
+                if (it == threads_.end())
+                {
+                    uint32_t id = threads_.size();
+                    it = threads_.emplace(tid, id).first;
+                    out.push_back(static_cast<char>(THREAD));
+                    PutVarint(out, id);
+                    PutVarint(out, tid);
+                }
+                last_tid_ = tid;
+                return last_thread_ = it->second;
+            }
+
+        private:
+            std::vector<bool> sites_;                       // 已定义的调用点
+            std::vector<std::string> loggers_;              // 已定义的日志器
+            std::unordered_map<uint64_t, uint32_t> threads_; // 线程ID -> 文件内编号
+            uint32_t last_logger_ = UINT32_MAX;
+            uint64_t last_tid_ = 0;
+            uint32_t last_thread_ = UINT32_MAX;
+            int64_t last_ts_ = 0;
+        };
+
+        // 读取端：将二进制日志文件还原为与LogMessage相同的文本
+        class Decoder
+        {
+        public:
+            // 解码整个文件内容，追加到out，格式错误时返回false(已解码的部分保留)
+            bool Decode(const char *data, size_t len, std::string &out)
+            {
+                if (len < sizeof(kMagic) + 1 || memcmp(data, kMagic, sizeof(kMagic)) != 0 ||
+                    static_cast<uint8_t>(data[sizeof(kMagic)]) != kVersion)
+                {
+                    return false;
+                }
+                Reader r(data + sizeof(kMagic) + 1, len - sizeof(kMagic) - 1);
+                while (!r.Eof())
+                {
+                    if (!DecodeEntry(r, out))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+        private:
+            struct Site
+            {
+                LogLevel::value level;
+                uint64_t line;
+                std::string file;
+                std::string format;
+            };
+
+            bool DecodeEntry(Reader &r, std::string &out)
+            {
+                uint8_t type;
+                uint64_t id, v;
+                std::string_view s1, s2;
+                if (!r.GetByte(type))
+                    return false;
+                switch (type)
+                {
+                case RESET:
+                    sites_.clear();
+                    loggers_.clear();
+                    threads_.clear();
+                    last_ts_ = 0;
+                    return true;
+                case SITE:
+                {
+                    uint8_t level;
+                    if (!r.GetVarint(id) || !r.GetByte(level) || !r.GetVarint(v) || !r.GetString(s1) || !r.GetString(s2))
+                        return false;
+                    sites_[id] = Site{static_cast<LogLevel::value>(level), v, std::string(s1), std::string(s2)};
+                    return true;
+                }
+                case LOGGER:
+                    if (!r.GetVarint(id) || !r.GetString(s1))
+                        return false;
+                    if (id >= loggers_.size())
+                        loggers_.resize(id + 1);
+                    loggers_[id] = std::string(s1);
+                    return true;
+                case THREAD:
+                    if (!r.GetVarint(id) || !r.GetVarint(v))
+                        return false;
+                    if (id >= threads_.size())
+                        threads_.resize(id + 1);
+                    threads_[id] = std::to_string(v);
+                    return true;
+                case TEXT:
+                    if (!r.GetString(s1))
+                        return false;
+                    out.append(s1.data(), s1.size());
+                    return true;
+                case RECORD:
+                    return DecodeRecord(r, out);
+                default:
+                    return false;
+                }
+            }
+
+            bool DecodeRecord(Reader &r, std::string &out)
+            {
+                uint64_t site_id, logger_id, thread_id, delta, nargs;
+                if (!r.GetVarint(site_id) || !r.GetVarint(logger_id) || !r.GetVarint(thread_id) ||
+                    !r.GetVarint(delta) || !r.GetVarint(nargs) || nargs > BinaryRecord::kMaxArgs)
+                    return false;
+                last_ts_ += UnZigZag(delta);
+                fmt::ArgValue args[BinaryRecord::kMaxArgs];
+                for (uint64_t i = 0; i < nargs; ++i)
+                {
+                    uint8_t tag, b;
+                    if (!r.GetByte(tag))
+                        return false;
+                    fmt::ArgValue &a = args[i];
+                    a.type = static_cast<fmt::ArgType>(tag);
+                    switch (a.type)
+                    {
+                    case fmt::ArgType::BOOL:
+                        if (!r.GetByte(b))
+                            return false;
+                        a.b = b != 0;
+                        break;
+                    case fmt::ArgType::CHAR:
+                        if (!r.GetByte(b))
+                            return false;
+                        a.c = static_cast<char>(b);
+                        break;
+                    case fmt::ArgType::INT:
+                        if (!r.GetVarint(a.u))
+                            return false;
+                        a.i = UnZigZag(a.u);
+                        break;
+                    case fmt::ArgType::UINT:
+                    case fmt::ArgType::POINTER:
+                        if (!r.GetVarint(a.u))
+                            return false;
+                        break;
+                    case fmt::ArgType::DOUBLE:
+                        if (!r.GetBytes(&a.d, sizeof(a.d)))
+                            return false;
+                        break;
+                    case fmt::ArgType::STRING:
+                        if (!r.GetString(a.s))
+                            return false;
+                        break;
+                    default:
+                        return false;
+                    }
+                }
+                auto site = sites_.find(site_id);
+                if (site == sites_.end() || logger_id >= loggers_.size() || thread_id >= threads_.size())
+                    return false;
+                const Site &s = site->second;
+                auto format = [&](LineWriter &w)
+                {
+                    LogMessage::FormatHeader(w, last_ts_, threads_[thread_id], s.level,
+                                             loggers_[logger_id], s.file.c_str(), s.line);
+                    fmt::FormatDynamic(w, s.format, args, nargs);
+                    w.Append('\n');
+                };
+                LineWriter count(nullptr, 0);
+                format(count);
+                size_t pos = out.size();
+                out.resize(pos + count.Length());
+                LineWriter w(&out[pos], count.Length());
+                format(w);
+                return true;
+            }
+
+        private:
+            std::unordered_map<uint64_t, Site> sites_;
+            std::vector<std::string> loggers_;
+            std::vector<std::string> threads_;
+            int64_t last_ts_ = 0;
+        };
+    }
+}
@@ -0,0 +1,310 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+
+#include "Format.hpp"
+#include "Level.hpp"
+#include "Message.hpp"
+
+namespace mylog
+{
+    // 日志调用点的静态信息，每个调用点只注册一次，记录中只携带其编号
+    struct CallSite
+    {
+        CallSite(const char *file, size_t line, LogLevel::value level, const char *format);
+
+        const char *file_;      // 文件名
+        size_t line_;           // 行号
+        LogLevel::value level_; // 日志级别
+        const char *format_;    // {}风格格式串
+        uint32_t id_;           // 注册后分配的编号，从1开始，0保留给已格式化的文本记录
+    };
+
+    // 调用点注册表 - 单例模式，注册加锁，按编号查询无锁
+    class CallSiteRegistry
+    {
+    public:
+        static CallSiteRegistry &GetInstance()
+        {
+            static CallSiteRegistry instance;
+            return instance;
+        }
+
+        uint32_t Register(const CallSite *site)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            uint32_t id = ++count_;
+            size_t chunk = id / kChunkSize;
+            if (chunk >= kMaxChunks)
+            {
+                std::cout << __FILE__ << __LINE__ << "too many log call sites" << std::endl;
+                return 0;
+            }
+            if (chunks_[chunk].load(std::memory_order_relaxed) == nullptr)
+            {
+                chunks_[chunk].store(new std::atomic<const CallSite *>[kChunkSize](), std::memory_order_release);
+            }
+            chunks_[chunk].load(std::memory_order_relaxed)[id % kChunkSize].store(site, std::memory_order_release);
+            return id;
+        }
+
+        // 按编号查询，未注册的编号返回nullptr
+        const CallSite *Get(uint32_t id) const
+        {
+            size_t chunk = id / kChunkSize;
+            if (id == 0 || chunk >= kMaxChunks)
+            {
+                return nullptr;
+            }
+            auto *sites = chunks_[chunk].load(std::memory_order_acquire);
+            return sites ? sites[id % kChunkSize].load(std::memory_order_acquire) : nullptr;
+        }
+
+    private:
+        static constexpr size_t kChunkSize = 1024;
+        static constexpr size_t kMaxChunks = 1024;
+
+        CallSiteRegistry() = default;
+        CallSiteRegistry(const CallSiteRegistry &) = delete;
+        CallSiteRegistry &operator=(const CallSiteRegistry &) = delete;
+
+        std::mutex mutex_;
+        uint32_t count_ = 0;
+        std::atomic<std::atomic<const CallSite *> *> chunks_[kMaxChunks] = {};
+    };
+
+    inline CallSite::CallSite(const char *file, size_t line, LogLevel::value level, const char *format)
+        : file_(file), line_(line), level_(level), format_(format), id_(0)
+    {
+        id_ = CallSiteRegistry::GetInstance().Register(this);
+    }
+
+    // 二进制日志记录，生产者只拷贝调用点编号和原始参数，由后台线程格式化
+    // 记录布局(小端，不对齐):
+    //   u32 记录总长度 | u32 调用点编号 | i64 时间戳(纳秒) | u64 线程ID | 参数...
+    //   每个参数为 u8 类型标签 + 值: BOOL/CHAR 1字节，INT/UINT/DOUBLE/POINTER 8字节，STRING u32长度+内容
+    // 调用点编号为0表示已格式化的文本记录，只有一个STRING参数，内容原样输出
+    class BinaryRecord
+    {
+    public:
+        static constexpr size_t kHeaderSize = 24;
+        static constexpr size_t kTextPrefix = kHeaderSize + 1 + 4; // 文本记录在文本之前的固定部分
+        static constexpr size_t kMaxArgs = 32;
+
+        // 编码整条记录，按snprintf语义返回所需长度，空间不足时不写入
+        template <typename... Args>
+        static size_t Encode(char *dst, size_t cap, uint32_t site, int64_t ts, uint64_t tid, const Args &...args)
+        {
+            static_assert(sizeof...(Args) <= kMaxArgs, "too many arguments for binary log record");
+            size_t total = kHeaderSize + (0 + ... + ArgSize(args));
+            if (total > cap)
+            {
+                return total;
+            }
+            char *p = dst;
+            Put(p, static_cast<uint32_t>(total));
+            Put(p, site);
+            Put(p, ts);
+            Put(p, tid);
+            (PutArg(p, args), ...);
+            return total;
+        }
+
+        // 写入文本记录的固定部分，文本本身由调用方写在dst + kTextPrefix处
+        static void EncodeTextPrefix(char *dst, size_t text_len, int64_t ts, uint64_t tid)
+        {
+            char *p = dst;
+            Put(p, static_cast<uint32_t>(kTextPrefix + text_len));
+            Put(p, static_cast<uint32_t>(0));
+            Put(p, ts);
+            Put(p, tid);
+            *p++ = static_cast<char>(fmt::ArgType::STRING);
+            Put(p, static_cast<uint32_t>(text_len));
+        }
+
+        // 已解码的记录
+        struct View
+        {
+            uint32_t site = 0;
+            int64_t ts = 0;
+            uint64_t tid = 0;
+            size_t nargs = 0;
+            fmt::ArgValue args[kMaxArgs];
+        };
+
+        // 解码data处的一条记录，返回记录长度，数据不完整或损坏时返回0
+        static size_t Decode(const char *data, size_t len, View &view)
+        {
+            if (len < kHeaderSize)
+            {
+                return 0;
+            }
+            const char *p = data;
+            uint32_t total = Get<uint32_t>(p);
+            if (total < kHeaderSize || total > len)
+            {
+                return 0;
+            }
+            const char *end = data + total;
+            view.site = Get<uint32_t>(p);
+            view.ts = Get<int64_t>(p);
+            view.tid = Get<uint64_t>(p);
+            view.nargs = 0;
+            while (p < end && view.nargs < kMaxArgs)
+            {
+                fmt::ArgValue &v = view.args[view.nargs++];
+                v.type = static_cast<fmt::ArgType>(*p++);
+                size_t need = ValueSize(v.type);
+                if (p + need > end)
+                {
+                    return 0;
+                }
+                switch (v.type)
+                {
+                case fmt::ArgType::BOOL:
+                    v.b = *p != 0;
+                    break;
+                case fmt::ArgType::CHAR:
+                    v.c = *p;
+                    break;
+                case fmt::ArgType::INT:
+                case fmt::ArgType::UINT:
+                case fmt::ArgType::DOUBLE:
+                case fmt::ArgType::POINTER:
+                    memcpy(&v.u, p, 8);
+                    break;
+                case fmt::ArgType::STRING:
+                {
+                    uint32_t n;
+                    memcpy(&n, p, 4);
+                    if (p + 4 + n > end)
+                    {
+                        return 0;
+                    }
+                    v.s = std::string_view(p + 4, n);
+                    need += n;
+                    break;
+                }
+                default:
+                    return 0;
+                }
+                p += need;
+            }
+            return total;
+        }
+
+        // 将一条已解码的记录格式化为与LogMessage相同的文本行
+        static void Format(LineWriter &w, const View &view, std::string_view logger_name)
+        {
+            if (view.site == 0)
+            {
+                if (view.nargs == 1 && view.args[0].type == fmt::ArgType::STRING)
+                {
+                    w.Append(view.args[0].s);
+                }
+                return;
+            }
+            const CallSite *site = CallSiteRegistry::GetInstance().Get(view.site);
+            if (site == nullptr)
+            {
+                return;
+            }
+            char tid[24];
+            auto r = std::to_chars(tid, tid + sizeof(tid), view.tid);
+            LogMessage::FormatHeader(w, view.ts, std::string_view(tid, r.ptr - tid), site->level_,
+                                     logger_name, site->file_, site->line_);
+            fmt::FormatDynamic(w, site->format_, view.args, view.nargs);
+            w.Append('\n');
+        }
+
+    private:
+        template <typename T>
+        static void Put(char *&p, T v)
+        {
+            memcpy(p, &v, sizeof(v));
+            p += sizeof(v);
+        }
+
+        template <typename T>
+        static T Get(const char *&p)
+        {
+            T v;
+            memcpy(&v, p, sizeof(v));
+            p += sizeof(v);
+            return v;
+        }
+
+        static size_t ValueSize(fmt::ArgType type)
+        {
+            switch (type)
+            {
+            case fmt::ArgType::BOOL:
+            case fmt::ArgType::CHAR:
+                return 1;
+            case fmt::ArgType::STRING:
+                return 4;
+            default:
+                return 8;
+            }
+        }
+
+        template <typename T>
+        static std::string_view AsString(const T &arg)
+        {
+            if constexpr (std::is_array_v<T>)
+                return std::string_view(arg);
+            else if constexpr (std::is_pointer_v<T>)
+                return arg ? std::string_view(arg) : std::string_view("(null)");
+            else
+                return std::string_view(arg);
+        }
+
+        template <typename T>
+        static size_t ArgSize(const T &arg)
+        {
+            constexpr fmt::ArgType type = fmt::TypeOf<T>();
+            if constexpr (type == fmt::ArgType::STRING)
+                return 1 + 4 + AsString(arg).size();
+            else
+                return 1 + ValueSize(type);
+        }
+
+        template <typename T>
+        static void PutArg(char *&p, const T &arg)
+        {
+            constexpr fmt::ArgType type = fmt::TypeOf<T>();
+            *p++ = static_cast<char>(type);
+            if constexpr (type == fmt::ArgType::BOOL || type == fmt::ArgType::CHAR)
+            {
+                *p++ = static_cast<char>(arg);
+            }
+            else if constexpr (type == fmt::ArgType::INT)
+            {
+                Put(p, static_cast<int64_t>(arg));
+            }
+            else if constexpr (type == fmt::ArgType::UINT)
+            {
+                Put(p, static_cast<uint64_t>(arg));
+            }
+            else if constexpr (type == fmt::ArgType::DOUBLE)
+            {
+                Put(p, static_cast<double>(arg));
+            }
+            else if constexpr (type == fmt::ArgType::POINTER)
+            {
+                Put(p, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(arg)));
+            }
+            else
+            {
+                std::string_view sv = AsString(arg);
+                Put(p, static_cast<uint32_t>(sv.size()));
+                memcpy(p, sv.data(), sv.size());
+                p += sv.size();
+            }
+        }
+    };
+}
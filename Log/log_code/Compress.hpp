@@ -0,0 +1,449 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 压缩库是可选的：有头文件时才编译对应的算法，链接时需要-lzstd/-llz4
+#if __has_include(<zstd.h>)
+#include <zstd.h>
+#define MYLOG_HAVE_ZSTD 1
+#endif
+#if __has_include(<lz4frame.h>)
+#include <lz4frame.h>
+#define MYLOG_HAVE_LZ4 1
+#endif
+
+#include "Util.hpp"
+#include "ThreadPool.hpp"
+
+extern mylog::Util::JsonData *g_conf_data;
+
+namespace mylog
+{
+    enum class CompressType
+    {
+        NONE,
+        ZSTD,
+        LZ4
+    };
+
+    // 压缩统计
+    struct CompressStats
+    {
+        std::atomic<uint64_t> files{0};        // 压缩完成的文件数
+        std::atomic<uint64_t> input_bytes{0};  // 原始字节数
+        std::atomic<uint64_t> output_bytes{0}; // 压缩后的字节数
+        std::atomic<uint64_t> failed{0};       // 压缩失败(保留原文件)的文件数
+    };
+
+    // 可随机访问的压缩格式：输入按frame_size切成相互独立的帧，文件末尾附加一个跳过帧作为索引表，
+    // 记录每帧压缩前后的大小，读取部分内容时只需解压相关的帧(与zstd seekable格式一致，lz4也使用同样的索引表)
+    // 普通的zstd/lz4命令行工具会跳过索引表，可以直接解压整个文件
+    class SeekableCompressor
+    {
+    public:
+        static constexpr uint32_t kSkippableMagic = 0x184D2A5E; // 跳过帧魔数(zstd和lz4通用)
+        static constexpr uint32_t kSeekableMagic = 0x8F92EAB1;  // 索引表尾部魔数
+
+        // 按名称解析压缩算法，未编译该算法时返回NONE
+        static CompressType Parse(const std::string &name)
+        {
+            CompressType type = CompressType::NONE;
+            if (name == "zstd")
+            {
+                type = CompressType::ZSTD;
+            }
+            else if (name == "lz4")
+            {
+                type = CompressType::LZ4;
+            }
+            if (type != CompressType::NONE && !Available(type))
+            {
+                std::cout << __FILE__ << __LINE__ << "compress " << name << " not available, rotated files are kept uncompressed" << std::endl;
+                return CompressType::NONE;
+            }
+            return type;
+        }
+
+        static bool Available([[maybe_unused]] CompressType type)
+        {
+#ifdef MYLOG_HAVE_ZSTD
+            if (type == CompressType::ZSTD)
+            {
+                return true;
+            }
+#endif
+#ifdef MYLOG_HAVE_LZ4
+            if (type == CompressType::LZ4)
+            {
+                return true;
+            }
+#endif
+            return false;
+        }
+
+        // 压缩文件的扩展名
+        static const char *Extension(CompressType type)
+        {
+            return type == CompressType::ZSTD ? ".zst" : ".lz4";
+        }
+
+        // 按扩展名判断压缩算法，不是压缩文件时返回NONE
+        static CompressType TypeOfFile(const std::string &path)
+        {
+            for (CompressType type : {CompressType::ZSTD, CompressType::LZ4})
+            {
+                std::string ext = Extension(type);
+                if (path.size() > ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0)
+                {
+                    return type;
+                }
+            }
+            return CompressType::NONE;
+        }
+
+        // 一个压缩帧的位置
+        struct Frame
+        {
+            uint64_t offset;     // 帧在压缩文件中的偏移
+            uint64_t raw_offset; // 帧解压后在原文件中的偏移
+            uint32_t size;       // 压缩后大小
+            uint32_t raw_size;   // 原始大小
+        };
+
+        // 读取文件末尾的索引表，格式不对时返回false
+        static bool ReadTable(const char *data, size_t len, std::vector<Frame> &frames)
+        {
+            if (len < 17 || GetU32(data + len - 4) != kSeekableMagic)
+            {
+                return false;
+            }
+            uint32_t n = GetU32(data + len - 9);
+            size_t table = 8 + static_cast<size_t>(n) * 8 + 9;
+            if (table > len || GetU32(data + len - table) != kSkippableMagic || data[len - 5] != '\0')
+            {
+                return false;
+            }
+            const char *p = data + len - table + 8;
+            uint64_t offset = 0, raw_offset = 0;
+            frames.clear();
+            for (uint32_t i = 0; i < n; ++i, p += 8)
+            {
+                Frame f{offset, raw_offset, GetU32(p), GetU32(p + 4)};
+                offset += f.size;
+                raw_offset += f.raw_size;
+                frames.push_back(f);
+            }
+            return offset <= len - table;
+        }
+
+        // 解压一个帧到dst(容量为帧的原始大小)，失败时返回false
+        static bool DecompressFrame([[maybe_unused]] CompressType type, [[maybe_unused]] const char *src, [[maybe_unused]] size_t len,
+                                    [[maybe_unused]] char *dst, [[maybe_unused]] size_t raw_len)
+        {
+#ifdef MYLOG_HAVE_ZSTD
+            if (type == CompressType::ZSTD)
+            {
+                size_t n = ZSTD_decompress(dst, raw_len, src, len);
+                return !ZSTD_isError(n) && n == raw_len;
+            }
+#endif
+#ifdef MYLOG_HAVE_LZ4
+            if (type == CompressType::LZ4)
+            {
+                LZ4F_dctx *ctx = nullptr;
+                if (LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION)))
+                {
+                    return false;
+                }
+                size_t out = 0, in = 0;
+                size_t ret = 1;
+                while (ret != 0 && in < len && out < raw_len)
+                {
+                    size_t dst_size = raw_len - out, src_size = len - in;
+                    ret = LZ4F_decompress(ctx, dst + out, &dst_size, src + in, &src_size, nullptr);
+                    if (LZ4F_isError(ret))
+                    {
+                        break;
+                    }
+                    out += dst_size;
+                    in += src_size;
+                }
+                LZ4F_freeDecompressionContext(ctx);
+                return !LZ4F_isError(ret) && out == raw_len;
+            }
+#endif
+            return false;
+        }
+
+        // 压缩[data, data+len)写入out
+        static bool Compress(CompressType type, int level, size_t frame_size, const char *data, size_t len, FILE *out)
+        {
+            frame_size = std::max<size_t>(frame_size, 4096);
+            std::vector<char> dst(Bound(type, std::min(frame_size, len)));
+            std::string table;
+            uint32_t frames = 0;
+            for (size_t off = 0; off < len; off += frame_size)
+            {
+                size_t n = std::min(frame_size, len - off);
+                size_t c = CompressFrame(type, level, dst.data(), dst.size(), data + off, n);
+                if (c == 0 || fwrite(dst.data(), 1, c, out) != c)
+                {
+                    return false;
+                }
+                PutU32(table, static_cast<uint32_t>(c));
+                PutU32(table, static_cast<uint32_t>(n));
+                ++frames;
+            }
+            // 索引表：跳过帧头 + 每帧(压缩大小, 原始大小) + 帧数 + 描述符 + 魔数
+            std::string footer;
+            PutU32(footer, kSkippableMagic);
+            PutU32(footer, static_cast<uint32_t>(table.size() + 9));
+            footer += table;
+            PutU32(footer, frames);
+            footer.push_back('\0'); // 描述符：不带校验和
+            PutU32(footer, kSeekableMagic);
+            return fwrite(footer.data(), 1, footer.size(), out) == footer.size();
+        }
+
+    private:
+        static uint32_t GetU32(const char *p)
+        {
+            uint32_t v = 0;
+            for (int i = 3; i >= 0; --i)
+            {
+                v = (v << 8) | static_cast<uint8_t>(p[i]);
+            }
+            return v;
+        }
+
+        static void PutU32(std::string &out, uint32_t v)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                out.push_back(static_cast<char>((v >> (8 * i)) & 0xff)); // 小端
+            }
+        }
+
+        static size_t Bound([[maybe_unused]] CompressType type, size_t n)
+        {
+#ifdef MYLOG_HAVE_ZSTD
+            if (type == CompressType::ZSTD)
+            {
+                return ZSTD_compressBound(n);
+            }
+#endif
+#ifdef MYLOG_HAVE_LZ4
+            if (type == CompressType::LZ4)
+            {
+                return LZ4F_compressFrameBound(n, nullptr);
+            }
+#endif
+            return n;
+        }
+
+        // 压缩一个独立的帧，失败时返回0
+        static size_t CompressFrame([[maybe_unused]] CompressType type, [[maybe_unused]] int level, [[maybe_unused]] char *dst,
+                                    [[maybe_unused]] size_t cap, [[maybe_unused]] const char *src, [[maybe_unused]] size_t n)
+        {
+#ifdef MYLOG_HAVE_ZSTD
+            if (type == CompressType::ZSTD)
+            {
+                size_t c = ZSTD_compress(dst, cap, src, n, level);
+                if (ZSTD_isError(c))
+                {
+                    std::cout << __FILE__ << __LINE__ << "zstd compress failed: " << ZSTD_getErrorName(c) << std::endl;
+                    return 0;
+                }
+                return c;
+            }
+#endif
+#ifdef MYLOG_HAVE_LZ4
+            if (type == CompressType::LZ4)
+            {
+                LZ4F_preferences_t prefs;
+                memset(&prefs, 0, sizeof(prefs));
+                prefs.compressionLevel = level;
+                prefs.frameInfo.contentSize = n; // 帧头记录原始大小
+                size_t c = LZ4F_compressFrame(dst, cap, src, n, &prefs);
+                if (LZ4F_isError(c))
+                {
+                    std::cout << __FILE__ << __LINE__ << "lz4 compress failed: " << LZ4F_getErrorName(c) << std::endl;
+                    return 0;
+                }
+                return c;
+            }
+#endif
+            return 0;
+        }
+    };
+
+    // 滚动出的日志文件在线程池中后台压缩，同时进行的压缩任务不超过compress_threads个，其余排队，
+    // 避免占满线程池或与日志的后台线程争抢CPU；压缩完成并落盘后才删除原文件，失败时保留原文件
+    class SegmentCompressor
+    {
+    public:
+        static SegmentCompressor &GetInstance()
+        {
+            static SegmentCompressor *instance = new SegmentCompressor; // 不析构，退出时线程池中的任务仍可访问
+            return *instance;
+        }
+
+        // 禁用拷贝和赋值
+        SegmentCompressor(const SegmentCompressor &) = delete;
+        SegmentCompressor &operator=(const SegmentCompressor &) = delete;
+
+        // 是否启用了压缩
+        bool Enabled() const { return type_ != CompressType::NONE; }
+
+        // 提交一个已关闭的文件
+        void Submit(const std::string &path)
+        {
+            if (!Enabled())
+            {
+                return;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_.push_back(path);
+            Dispatch(lock);
+        }
+
+        // 等待已提交的文件全部压缩完成
+        void Wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]()
+                     { return queue_.empty() && running_ == 0; });
+        }
+
+        const CompressStats &Stats() const { return stats_; }
+
+    private:
+        SegmentCompressor()
+            : type_(SeekableCompressor::Parse(g_conf_data->compress)), level_(g_conf_data->compress_level),
+              frame_size_(g_conf_data->compress_frame_size),
+              max_running_(std::max<size_t>(1, g_conf_data->compress_threads)) {}
+
+        // 在并发上限内把排队的文件交给线程池，调用方需持有mutex_
+        void Dispatch(std::unique_lock<std::mutex> & /*lock*/)
+        {
+            ThreadPool &pool = ThreadPool::Background(g_conf_data->thread_count);
+            while (running_ < max_running_ && !queue_.empty())
+            {
+                std::string path = std::move(queue_.front());
+                queue_.pop_front();
+                ++running_;
+                try
+                {
+                    pool.post([this, path]()
+                              { Run(path); });
+                }
+                catch (const std::runtime_error &)
+                {
+                    --running_;
+                    std::cout << __FILE__ << __LINE__ << "thread pool closed, " << path << " is kept uncompressed" << std::endl;
+                }
+            }
+            cv_.notify_all();
+        }
+
+        void Run(const std::string &path)
+        {
+            if (!CompressFile(path))
+            {
+                stats_.failed.fetch_add(1, std::memory_order_relaxed);
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            --running_;
+            Dispatch(lock);
+        }
+
+        // 压缩到临时文件，落盘后改名并删除原文件
+        bool CompressFile(const std::string &path)
+        {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0 && errno == ENOENT)
+            {
+                return true; // 排队期间已被保留策略删除
+            }
+            if (fd < 0)
+            {
+                std::cout << __FILE__ << __LINE__ << "open file " << path << " failed" << std::endl;
+                perror(NULL);
+                return false;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0)
+            {
+                close(fd);
+                return false;
+            }
+            size_t len = st.st_size;
+            void *data = nullptr;
+            if (len > 0)
+            {
+                data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data == MAP_FAILED)
+                {
+                    std::cout << __FILE__ << __LINE__ << "mmap file " << path << " failed" << std::endl;
+                    perror(NULL);
+                    close(fd);
+                    return false;
+                }
+                madvise(data, len, MADV_SEQUENTIAL);
+            }
+            close(fd);
+
+            std::string target = path + SeekableCompressor::Extension(type_);
+            std::string tmp = target + ".tmp";
+            FILE *out = fopen(tmp.c_str(), "wb");
+            bool ok = out != NULL &&
+                      SeekableCompressor::Compress(type_, level_, frame_size_, static_cast<const char *>(data), len, out) &&
+                      fflush(out) == 0 && fsync(fileno(out)) == 0;
+            size_t out_len = out != NULL ? ftell(out) : 0;
+            if (out != NULL)
+            {
+                fclose(out);
+            }
+            if (data != nullptr)
+            {
+                munmap(data, len);
+            }
+            if (!ok || rename(tmp.c_str(), target.c_str()) != 0)
+            {
+                std::cout << __FILE__ << __LINE__ << "compress file " << path << " failed" << std::endl;
+                perror(NULL);
+                unlink(tmp.c_str());
+                return false;
+            }
+            unlink(path.c_str());
+            stats_.files.fetch_add(1, std::memory_order_relaxed);
+            stats_.input_bytes.fetch_add(len, std::memory_order_relaxed);
+            stats_.output_bytes.fetch_add(out_len, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        CompressType type_;
+        int level_;
+        size_t frame_size_;
+        size_t max_running_;            // 同时进行的压缩任务数上限
+        std::mutex mutex_;
+        std::condition_variable cv_;    // 通知Wait
+        std::deque<std::string> queue_; // 等待压缩的文件
+        size_t running_ = 0;            // 正在压缩的文件数
+        CompressStats stats_;
+    };
+}
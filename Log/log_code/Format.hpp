@@ -0,0 +1,438 @@
+#pragma once
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "Message.hpp"
+
+// C++20下格式串在编译期解析和检查；C++17下BasicFormatString每次构造都在运行期解析，
+// 经MyLog.hpp的*Fmt宏调用时由FormatSite为每个调用点缓存首次解析的结果，格式串有误时打印一次错误并原样输出
+#if __cplusplus >= 202002L
+#define MYLOG_CONSTEVAL consteval
+#else
+#define MYLOG_CONSTEVAL constexpr
+#endif
+
+namespace mylog
+{
+    namespace fmt
+    {
+        // 参数类别，格式串检查和输出都以此为准
+        enum class ArgType : uint8_t
+        {
+            BOOL,
+            CHAR,
+            INT,
+            UINT,
+            DOUBLE,
+            STRING,
+            POINTER
+        };
+
+        template <typename T>
+        struct AlwaysFalse : std::false_type
+        {
+        };
+
+        // 推导参数类别，不支持的类型在编译期报错
+        template <typename T>
+        constexpr ArgType TypeOf()
+        {
+            using D = std::decay_t<T>;
+            if constexpr (std::is_same_v<D, bool>)
+                return ArgType::BOOL;
+            else if constexpr (std::is_same_v<D, char>)
+                return ArgType::CHAR;
+            else if constexpr (std::is_integral_v<D> && std::is_signed_v<D>)
+                return ArgType::INT;
+            else if constexpr (std::is_integral_v<D>)
+                return ArgType::UINT;
+            else if constexpr (std::is_floating_point_v<D>)
+                return ArgType::DOUBLE;
+            else if constexpr (std::is_same_v<D, const char *> || std::is_same_v<D, char *> ||
+                               std::is_convertible_v<const D &, std::string_view>)
+                return ArgType::STRING;
+            else if constexpr (std::is_pointer_v<D>)
+                return ArgType::POINTER;
+            else
+                static_assert(AlwaysFalse<T>::value, "mylog::fmt: unsupported argument type");
+        }
+
+        // 以下函数故意不是constexpr：编译期解析走到这里即报错，函数名就是错误信息
+        inline void error_too_many_placeholders() {}
+        inline void error_too_few_placeholders() {}
+        inline void error_unmatched_brace() {}
+        inline void error_bad_format_spec() {}
+        inline void error_spec_does_not_match_argument_type() {}
+
+        // 占位符说明
+        struct Spec
+        {
+            uint32_t lit_begin = 0; // 占位符之前的字面文本起点
+            uint32_t lit_end = 0;   // 字面文本终点(即占位符起点)
+            bool escaped = false;   // 字面文本中含有 {{ 或 }}
+            char kind = 0;          // 0默认，'x'十六进制，'f'定点小数
+            uint8_t precision = 0;  // 定点小数位数
+        };
+
+        // 按参数类型输出单个参数
+        template <typename T>
+        void WriteArg(LineWriter &w, const Spec &spec, const T &arg)
+        {
+            constexpr ArgType type = TypeOf<T>();
+            if constexpr (type == ArgType::BOOL)
+            {
+                w.Append(arg ? "true" : "false");
+            }
+            else if constexpr (type == ArgType::CHAR)
+            {
+                w.Append(arg);
+            }
+            else if constexpr (type == ArgType::INT || type == ArgType::UINT)
+            {
+                char buf[72];
+                auto r = spec.kind == 'x'
+                             ? std::to_chars(buf, buf + sizeof(buf), static_cast<std::make_unsigned_t<T>>(arg), 16)
+                             : std::to_chars(buf, buf + sizeof(buf), arg);
+                w.Append(buf, r.ptr - buf);
+            }
+            else if constexpr (type == ArgType::DOUBLE)
+            {
+                char buf[64];
+                auto r = spec.kind == 'f'
+                             ? std::to_chars(buf, buf + sizeof(buf), arg, std::chars_format::fixed, spec.precision)
+                             : std::to_chars(buf, buf + sizeof(buf), arg);
+                if (r.ec == std::errc())
+                {
+                    w.Append(buf, r.ptr - buf);
+                }
+                else
+                {
+                    int n = snprintf(buf, sizeof(buf), "%g", static_cast<double>(arg)); // 超长的定点数退回科学计数法
+                    w.Append(buf, std::min<size_t>(n, sizeof(buf) - 1));
+                }
+            }
+            else if constexpr (type == ArgType::STRING)
+            {
+                if constexpr (std::is_array_v<T>)
+                {
+                    w.Append(arg);
+                }
+                else if constexpr (std::is_pointer_v<T>)
+                {
+                    w.Append(arg ? arg : "(null)");
+                }
+                else
+                {
+                    std::string_view sv(arg);
+                    w.Append(sv.data(), sv.size());
+                }
+            }
+            else
+            {
+                char buf[24];
+                auto r = std::to_chars(buf, buf + sizeof(buf), reinterpret_cast<uintptr_t>(arg), 16);
+                w.Append("0x", 2);
+                w.Append(buf, r.ptr - buf);
+            }
+        }
+
+        // 带参数类型的格式串，支持 {}、{:x}(整数/指针)、{:.N}(浮点，N为0-9)以及 {{ }} 转义
+        template <typename... Args>
+        class BasicFormatString
+        {
+        public:
+            template <typename S, typename = std::enable_if_t<std::is_convertible_v<const S &, std::string_view>>>
+            MYLOG_CONSTEVAL BasicFormatString(const S &str) : str_(str)
+            {
+                Parse();
+            }
+
+            std::string_view Get() const { return str_; }
+
+            // 解析是否成功，C++20下总是成功(失败即编译错误)
+            bool Valid() const { return valid_; }
+
+            // 按解析结果输出，每个参数类型对应一段专门的输出代码
+            template <typename... A>
+            void Format(LineWriter &w, const A &...args) const
+            {
+                if (!valid_)
+                {
+                    w.Append(str_.data(), str_.size()); // 运行期解析失败时原样输出
+                    return;
+                }
+                size_t i = 0;
+                (WriteOne(w, specs_[i++], args), ...);
+                AppendLiteral(w, tail_begin_, str_.size(), tail_escaped_);
+            }
+
+        private:
+            static constexpr size_t kArgs = sizeof...(Args);
+
+            MYLOG_CONSTEVAL void Parse()
+            {
+                constexpr ArgType types[] = {TypeOf<Args>()..., ArgType::BOOL};
+                if (str_.size() > UINT32_MAX)
+                {
+                    error_bad_format_spec(); // 偏移按32位存放
+                    valid_ = false;
+                    return;
+                }
+                size_t n = 0, lit = 0;
+                bool escaped = false;
+                for (size_t i = 0; i < str_.size(); ++i)
+                {
+                    char c = str_[i];
+                    if (c == '}')
+                    {
+                        if (i + 1 < str_.size() && str_[i + 1] == '}')
+                        {
+                            escaped = true;
+                            ++i;
+                            continue;
+                        }
+                        error_unmatched_brace();
+                        valid_ = false;
+                        return;
+                    }
+                    if (c != '{')
+                    {
+                        continue;
+                    }
+                    if (i + 1 < str_.size() && str_[i + 1] == '{')
+                    {
+                        escaped = true;
+                        ++i;
+                        continue;
+                    }
+                    if (n >= kArgs)
+                    {
+                        error_too_many_placeholders();
+                        valid_ = false;
+                        return;
+                    }
+                    Spec spec;
+                    spec.lit_begin = lit;
+                    spec.lit_end = i;
+                    spec.escaped = escaped;
+                    size_t j = i + 1;
+                    if (j < str_.size() && str_[j] == ':')
+                    {
+                        ++j;
+                        if (j < str_.size() && str_[j] == 'x')
+                        {
+                            spec.kind = 'x';
+                            ++j;
+                            if (types[n] != ArgType::INT && types[n] != ArgType::UINT && types[n] != ArgType::POINTER)
+                            {
+                                error_spec_does_not_match_argument_type();
+                                valid_ = false;
+                                return;
+                            }
+                        }
+                        else if (j + 1 < str_.size() && str_[j] == '.' && str_[j + 1] >= '0' && str_[j + 1] <= '9')
+                        {
+                            spec.kind = 'f';
+                            spec.precision = str_[j + 1] - '0';
+                            j += 2;
+                            if (types[n] != ArgType::DOUBLE)
+                            {
+                                error_spec_does_not_match_argument_type();
+                                valid_ = false;
+                                return;
+                            }
+                        }
+                    }
+                    if (j >= str_.size() || str_[j] != '}')
+                    {
+                        error_bad_format_spec();
+                        valid_ = false;
+                        return;
+                    }
+                    specs_[n++] = spec;
+                    i = j;
+                    lit = j + 1;
+                    escaped = false;
+                }
+                if (n != kArgs)
+                {
+                    error_too_few_placeholders();
+                    valid_ = false;
+                    return;
+                }
+                tail_begin_ = lit;
+                tail_escaped_ = escaped;
+            }
+
+            void AppendLiteral(LineWriter &w, size_t begin, size_t end, bool escaped) const
+            {
+                if (!escaped)
+                {
+                    w.Append(str_.data() + begin, end - begin);
+                    return;
+                }
+                for (size_t i = begin; i < end; ++i)
+                {
+                    w.Append(str_[i]);
+                    if ((str_[i] == '{' || str_[i] == '}') && i + 1 < end && str_[i + 1] == str_[i])
+                    {
+                        ++i; // 跳过转义的第二个括号
+                    }
+                }
+            }
+
+            template <typename T>
+            void WriteOne(LineWriter &w, const Spec &spec, const T &arg) const
+            {
+                AppendLiteral(w, spec.lit_begin, spec.lit_end, spec.escaped);
+                WriteArg(w, spec, arg);
+            }
+
+        private:
+            std::string_view str_;
+            Spec specs_[kArgs ? kArgs : 1] = {};
+            size_t tail_begin_ = 0;      // 最后一个占位符之后的字面文本起点
+            bool tail_escaped_ = false;  // 尾部文本中含有转义
+            bool valid_ = true;          // 解析是否成功，C++17下在运行期解析，失败时Format原样输出格式串
+        };
+
+        // 参数类型不参与推导，由日志调用的实参决定
+        template <typename... Args>
+        using FormatString = BasicFormatString<std::decay_t<Args>...>;
+
+        // C++17下*Fmt宏的调用点缓存：首次调用时按该调用点的参数类型解析格式串，之后只需一次原子读取
+        // 同一调用点的参数类型固定，解析结果不释放(与调用点的静态对象同生命周期)
+        class FormatSite
+        {
+        public:
+            explicit FormatSite(const char *str) : str_(str) {}
+
+            template <typename... Args>
+            const FormatString<Args...> &Get()
+            {
+                const void *parsed = parsed_.load(std::memory_order_acquire);
+                if (parsed == nullptr)
+                {
+                    auto *format = new FormatString<Args...>(str_);
+                    if (parsed_.compare_exchange_strong(parsed, format, std::memory_order_acq_rel))
+                    {
+                        parsed = format;
+                        if (!format->Valid())
+                        {
+                            std::cout << __FILE__ << __LINE__ << "invalid format string: " << str_ << std::endl;
+                        }
+                    }
+                    else
+                    {
+                        delete format; // 其他线程已先解析
+                    }
+                }
+                return *static_cast<const FormatString<Args...> *>(parsed);
+            }
+
+        private:
+            const char *str_;
+            std::atomic<const void *> parsed_{nullptr};
+        };
+
+        // 取得格式串的解析结果：BasicFormatString本身即是，FormatSite取调用点缓存
+        template <typename... Args, typename... Types>
+        const BasicFormatString<Types...> &Resolve(const BasicFormatString<Types...> &format)
+        {
+            return format;
+        }
+
+        template <typename... Args>
+        const FormatString<Args...> &Resolve(FormatSite &site)
+        {
+            return site.template Get<Args...>();
+        }
+
+        // 运行期参数值，供后台线程和解码工具按类型标签还原参数后格式化
+        struct ArgValue
+        {
+            ArgType type = ArgType::INT;
+            union
+            {
+                bool b;
+                char c;
+                int64_t i;
+                uint64_t u;
+                double d;
+            };
+            std::string_view s;
+
+            ArgValue() : i(0) {}
+        };
+
+        inline void WriteValue(LineWriter &w, const Spec &spec, const ArgValue &v)
+        {
+            switch (v.type)
+            {
+            case ArgType::BOOL:
+                WriteArg(w, spec, v.b);
+                break;
+            case ArgType::CHAR:
+                WriteArg(w, spec, v.c);
+                break;
+            case ArgType::INT:
+                WriteArg(w, spec, v.i);
+                break;
+            case ArgType::UINT:
+                WriteArg(w, spec, v.u);
+                break;
+            case ArgType::DOUBLE:
+                WriteArg(w, spec, v.d);
+                break;
+            case ArgType::STRING:
+                WriteArg(w, spec, v.s);
+                break;
+            case ArgType::POINTER:
+                WriteArg(w, spec, reinterpret_cast<const void *>(static_cast<uintptr_t>(v.u)));
+                break;
+            }
+        }
+
+        // 运行期解析格式串并输出，格式串在编译期已检查过，这里只做宽松处理:
+        // 参数不足时占位符原样输出，无法识别的说明符按默认格式输出
+        inline void FormatDynamic(LineWriter &w, std::string_view format, const ArgValue *args, size_t n)
+        {
+            size_t next = 0;
+            for (size_t i = 0; i < format.size(); ++i)
+            {
+                char c = format[i];
+                if ((c == '{' || c == '}') && i + 1 < format.size() && format[i + 1] == c)
+                {
+                    w.Append(c);
+                    ++i;
+                    continue;
+                }
+                size_t close = c == '{' ? format.find('}', i) : std::string_view::npos;
+                if (close == std::string_view::npos || next >= n)
+                {
+                    w.Append(c);
+                    continue;
+                }
+                Spec spec;
+                std::string_view sv = format.substr(i + 1, close - i - 1);
+                if (sv == ":x")
+                {
+                    spec.kind = 'x';
+                }
+                else if (sv.size() == 3 && sv[0] == ':' && sv[1] == '.' && sv[2] >= '0' && sv[2] <= '9')
+                {
+                    spec.kind = 'f';
+                    spec.precision = sv[2] - '0';
+                }
+                WriteValue(w, spec, args[next++]);
+                i = close;
+            }
+        }
+    }
+}
@@ -1,14 +1,193 @@
 #pragma once
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <string_view>
 #include "Util.hpp"
+#include "AsyncBuffer.hpp"
+#include "BinaryFile.hpp"
+#include "Compress.hpp"
+#include "TimeIndex.hpp"
 
 extern mylog::Util::JsonData *g_conf_data;
 
 namespace mylog
 {
+    // 落盘统计，用于观察组提交在吞吐和持久化延迟之间的取舍
+    struct SyncStats
+    {
+        std::atomic<uint64_t> syncs{0};       // 落盘次数
+        std::atomic<uint64_t> forced{0};      // 其中由ERROR/FATAL或WaitDurable强制触发的次数
+        std::atomic<uint64_t> bytes{0};       // 落盘覆盖的字节数
+        std::atomic<uint64_t> sync_ns{0};     // fsync累计耗时(纳秒)
+        std::atomic<uint64_t> max_sync_ns{0}; // 单次fsync最长耗时
+        std::atomic<uint64_t> lag_ns{0};      // 数据从写入到落盘的累计等待，按每次落盘中最早的写入计
+        std::atomic<uint64_t> max_lag_ns{0};  // 单次最长等待
+    };
+
+    // 组提交策略：flush_log为3时，距最早的未落盘写入超过sync_interval毫秒或累计sync_bytes字节才落盘一次，
+    // 多个批次共用一次fsync；flush_log为2时每批都落盘；强制落盘(force)只要有未落盘的数据就立即执行
+    class GroupCommit
+    {
+    public:
+        // 一次落盘覆盖的数据，异步落盘时在完成后交给End
+        struct Ticket
+        {
+            int64_t start = 0; // 落盘开始时间
+            int64_t first = 0; // 最早的未落盘写入时间
+            size_t bytes = 0;  // 覆盖的字节数
+            bool force = false;
+        };
+
+        // 记录写入了len字节
+        void Written(size_t len)
+        {
+            if (pending_ == 0)
+            {
+                first_ = Now();
+            }
+            pending_ += len;
+        }
+
+        // 是否应当落盘
+        bool Due(bool force) const
+        {
+            if (pending_ == 0)
+            {
+                return false;
+            }
+            if (force || g_conf_data->flush_log == 2)
+            {
+                return true;
+            }
+            return g_conf_data->flush_log == 3 &&
+                   (pending_ >= g_conf_data->sync_bytes ||
+                    Now() - first_ >= static_cast<int64_t>(g_conf_data->sync_interval) * 1000000);
+        }
+
+        // 开始落盘，此前写入的数据都计入本次
+        Ticket Begin(bool force)
+        {
+            Ticket t;
+            t.start = Now();
+            t.first = first_;
+            t.bytes = pending_;
+            t.force = force;
+            pending_ = 0;
+            return t;
+        }
+
+        // 落盘完成，更新统计
+        void End(const Ticket &t)
+        {
+            int64_t now = Now();
+            uint64_t cost = now - t.start, lag = now - t.first;
+            stats_.syncs.fetch_add(1, std::memory_order_relaxed);
+            stats_.forced.fetch_add(t.force, std::memory_order_relaxed);
+            stats_.bytes.fetch_add(t.bytes, std::memory_order_relaxed);
+            stats_.sync_ns.fetch_add(cost, std::memory_order_relaxed);
+            stats_.lag_ns.fetch_add(lag, std::memory_order_relaxed);
+            if (cost > stats_.max_sync_ns.load(std::memory_order_relaxed))
+            {
+                stats_.max_sync_ns.store(cost, std::memory_order_relaxed);
+            }
+            if (lag > stats_.max_lag_ns.load(std::memory_order_relaxed))
+            {
+                stats_.max_lag_ns.store(lag, std::memory_order_relaxed);
+            }
+        }
+
+        // 同步落盘
+        template <typename F>
+        void Sync(bool force, F &&fsync_fn)
+        {
+            Ticket t = Begin(force);
+            fsync_fn();
+            End(t);
+        }
+
+        const SyncStats &Stats() const { return stats_; }
+
+    private:
+        static int64_t Now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+        size_t pending_ = 0; // 未落盘的字节数
+        int64_t first_ = 0;  // 最早的未落盘写入时间
+        SyncStats stats_;    // 只由后台线程更新，可在其他线程读取
+    };
+
+    // 一批日志数据，多个输出方式共享同一份只读缓冲区，不再按输出方式拷贝
+    struct Batch
+    {
+        std::shared_ptr<Buffer> buffer;   // 批次数据，发出后不再修改
+        bool binary = false;              // 是否为二进制日志器的原始记录，否则为文本
+        std::string_view logger_name;     // 日志器名称，二进制记录格式化时使用
+    };
+
+    // 批次缓冲区池，批次的最后一个引用释放时缓冲区重置后回到池中
+    class BatchPool : public std::enable_shared_from_this<BatchPool>
+    {
+    public:
+        using ptr = std::shared_ptr<BatchPool>;
+
+        std::shared_ptr<Buffer> Acquire()
+        {
+            Buffer *buffer = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (!free_.empty())
+                {
+                    buffer = free_.back().release();
+                    free_.pop_back();
+                }
+            }
+            if (buffer == nullptr)
+            {
+                buffer = new Buffer();
+            }
+            std::weak_ptr<BatchPool> pool = shared_from_this();
+            return std::shared_ptr<Buffer>(buffer, [pool](Buffer *b)
+                                           {
+                                               auto p = pool.lock();
+                                               if (p)
+                                                   p->Release(b);
+                                               else
+                                                   delete b; });
+        }
+
+    private:
+        static constexpr size_t kMaxFree = 8; // 最多缓存的空闲缓冲区
+
+        void Release(Buffer *buffer)
+        {
+            buffer->Reset();
+            buffer->Shrink();
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (free_.size() < kMaxFree)
+            {
+                free_.emplace_back(buffer);
+                return;
+            }
+            lock.unlock();
+            delete buffer;
+        }
+
+        std::mutex mutex_;
+        std::vector<std::unique_ptr<Buffer>> free_;
+    };
+
     // 日志刷新基类
     class LogFlush
     {
@@ -17,6 +196,31 @@ namespace mylog
         virtual ~LogFlush() = default;
         // 纯虚函数，定义日志刷新接口
         virtual void Flush(const char *data, size_t len) = 0;
+
+        // 是否直接接收二进制日志器的原始记录(见BinaryLog.hpp)，否则接收格式化后的文本
+        virtual bool AcceptsBinary() const { return false; }
+
+        // 接收二进制日志器的原始记录，仅在AcceptsBinary()为真时调用
+        virtual void FlushBinary(std::string_view /*logger_name*/, const char * /*data*/, size_t /*len*/) {}
+
+        // 直接接管整个缓冲区(通过Swap换回一个空闲缓冲区)，省去一次拷贝；不支持时返回false，改走Flush
+        // 仅在该缓冲区没有其他输出方式需要读取时调用
+        virtual bool TakeBuffer(Buffer & /*buffer*/) { return false; }
+
+        // 等待已提交的异步写入全部完成，消费者线程退出前调用
+        virtual void Wait() {}
+
+        // 按落盘策略检查是否需要落盘，force为真时立即落盘所有已写入的数据；由后台线程在每批之后和空闲时调用
+        virtual void Sync(bool /*force*/) {}
+
+        // 落盘统计，不落盘的输出方式返回nullptr
+        virtual const SyncStats *GetSyncStats() const { return nullptr; }
+
+        // 是否在自己的线程中排队写入(见QueuedFlush.hpp)，是则通过FlushBatch共享批次
+        virtual bool Queued() const { return false; }
+
+        // 接收共享批次，仅在Queued()为真时调用
+        virtual void FlushBatch(const Batch & /*batch*/) {}
     };
 
     // 将日志输出到标准输出的实现类
@@ -45,11 +249,20 @@ namespace mylog
                 // 打开文件失败时输出错误信息
                 std::cout << __FILE__ << __LINE__ << "open file " << filename << " failed" << std::endl;
                 perror(NULL);
+                return;
+            }
+            if (g_conf_data->time_index)
+            {
+                struct stat st;
+                size_ = fstat(fileno(fs_), &st) == 0 ? st.st_size : 0;
+                index_.Open(filename + ".idx", g_conf_data->time_index_bucket);
             }
         }
 
         void Flush(const char *data, size_t len) override
         {
+            index_.Add(data, len, size_); // 记录各时间桶的起始偏移
+            size_ += len;
             // 将日志写入文件
             fwrite(data, 1, len, fs_);
             if (ferror(fs_))
@@ -60,7 +273,7 @@ namespace mylog
             }
 
             // 根据配置决定是否刷新文件缓冲区
-            if (g_conf_data->flush_log == 1)
+            if (g_conf_data->flush_log == 1 || g_conf_data->flush_log == 3)
             {
                 if (fflush(fs_) == EOF)
                 {
@@ -68,32 +281,97 @@ namespace mylog
                     perror(NULL);
                 }
             }
-            else if (g_conf_data->flush_log == 2)
+            commit_.Written(len);
+            Sync(false);
+        }
+
+        void Sync(bool force) override
+        {
+            if (fs_ != NULL && commit_.Due(force))
             {
-                fflush(fs_);
-                fsync(fileno(fs_));
+                commit_.Sync(force, [this]()
+                             { fflush(fs_); fsync(fileno(fs_)); });
             }
         }
 
+        const SyncStats *GetSyncStats() const override { return &commit_.Stats(); }
+
     private:
         std::string filename_; // 文件名
         FILE *fs_ = NULL;      // 文件指针
+        GroupCommit commit_;   // 落盘策略
+        size_t size_ = 0;      // 文件大小，即下一次写入的偏移
+        timeindex::Writer index_; // 时间索引，配置time_index时写入
     };
 
-    // 支持日志文件滚动的实现类
+    // 按时间滚动的周期
+    enum class RollPeriod
+    {
+        NONE,   // 只按大小滚动
+        HOURLY, // 每个整点
+        DAILY   // 每天零点(本地时间)
+    };
+
+    // 日志文件滚动和保留策略
+    struct RollOptions
+    {
+        size_t max_size = 0;      // 单个文件的最大字节数，0表示不按大小滚动
+        RollPeriod period = RollPeriod::NONE;
+        size_t max_files = 0;     // 最多保留的文件数(含压缩后的文件)，0表示不限
+        size_t max_bytes = 0;     // 最多保留的总字节数，0表示不限
+        bool preallocate = false; // 用fallocate为新文件预留max_size字节，减少文件碎片
+
+        static RollPeriod ParsePeriod(const std::string &name)
+        {
+            if (name == "hourly")
+            {
+                return RollPeriod::HOURLY;
+            }
+            if (name == "daily")
+            {
+                return RollPeriod::DAILY;
+            }
+            return RollPeriod::NONE;
+        }
+
+        // 配置文件中的滚动和保留策略
+        static RollOptions FromConfig(size_t max_size)
+        {
+            RollOptions options;
+            options.max_size = max_size;
+            options.period = ParsePeriod(g_conf_data->roll_period);
+            options.max_files = g_conf_data->roll_max_files;
+            options.max_bytes = g_conf_data->roll_max_bytes;
+            options.preallocate = g_conf_data->roll_preallocate;
+            return options;
+        }
+    };
+
+    // 支持日志文件滚动的实现类：按大小和/或按小时、天滚动，文件名为"基础文件名YYYYMMDD-HHMMSS-序号.log"，
+    // 各字段定长补零，按文件名排序即按时间排序；滚动后在线程池中清理超出保留策略的最旧文件
     class RollFileFlush : public LogFlush
     {
     public:
         using ptr = std::shared_ptr<RollFileFlush>;
-        RollFileFlush(const std::string &filename, size_t max_size) : basename_(filename), max_size_(max_size)
+        RollFileFlush(const std::string &filename, size_t max_size)
+            : RollFileFlush(filename, RollOptions::FromConfig(max_size)) {}
+
+        RollFileFlush(const std::string &filename, const RollOptions &options)
+            : max_size_(options.max_size), basename_(filename), options_(options)
         {
             // 创建目录
             Util::File::CreateDirectory(Util::File::Path(filename));
         }
 
+        ~RollFileFlush()
+        {
+            CloseFile();
+        }
+
         void Flush(const char *data, size_t len) override
         {
             InitLogFile(); // 初始化日志文件
+            index_.Add(data, len, cur_size_); // 记录各时间桶的起始偏移
             fwrite(data, 1, len, fs_);
             if (ferror(fs_))
             {
@@ -104,7 +382,7 @@ namespace mylog
 
             cur_size_ += len; // 更新当前文件大小
             // 根据配置决定是否刷新文件缓冲区
-            if (g_conf_data->flush_log == 1)
+            if (g_conf_data->flush_log == 1 || g_conf_data->flush_log == 3)
             {
                 if (fflush(fs_))
                 {
@@ -112,54 +390,548 @@ namespace mylog
                     perror(NULL);
                 }
             }
-            else if (g_conf_data->flush_log == 2)
+            commit_.Written(len);
+            Sync(false);
+        }
+
+        void Sync(bool force) override
+        {
+            if (fs_ != NULL && commit_.Due(force))
             {
-                fflush(fs_);
-                fsync(fileno(fs_));
+                commit_.Sync(force, [this]()
+                             { fflush(fs_); fsync(fileno(fs_)); });
             }
         }
 
+        const SyncStats *GetSyncStats() const override { return &commit_.Stats(); }
+
     private:
-        // 初始化日志文件
+        // 初始化日志文件，文件写满或到达滚动时间时换新文件
         void InitLogFile()
         {
-            if (fs_ == NULL || cur_size_ >= max_size_)
+            if (fs_ != NULL && (max_size_ == 0 || cur_size_ < max_size_) &&
+                (roll_at_ == 0 || Util::Date::Now() < roll_at_))
+            {
+                return;
+            }
+            std::string closed; // 刚写完的文件
+            if (fs_ != NULL)
+            {
+                CloseFile();
+                SegmentCompressor::GetInstance().Submit(filename_); // 配置了compress时在线程池中后台压缩
+                closed = filename_;
+            }
+            filename_ = CreateFileName(); // 创建新的文件名
+            fs_ = fopen(filename_.c_str(), "ab");
+            if (!closed.empty())
             {
-                if (fs_ != NULL)
+                EnforceRetention(closed); // 新文件打开后再清理，打开失败(如磁盘满)时也清理
+            }
+            if (fs_ == NULL)
+            {
+                // 打开文件失败时输出错误信息
+                std::cout << __FILE__ << __LINE__ << "open file " << filename_ << " failed" << std::endl;
+                perror(NULL);
+                return;
+            }
+            struct stat st;
+            cur_size_ = fstat(fileno(fs_), &st) == 0 ? st.st_size : 0; // 同名文件已存在时接着写
+            if (g_conf_data->time_index)
+            {
+                index_.Open(filename_ + ".idx", g_conf_data->time_index_bucket);
+            }
+            if (options_.preallocate && max_size_ > cur_size_)
+            {
+                // 只预留空间不改变文件大小，追加写和按大小读取都不受影响
+                if (fallocate(fileno(fs_), FALLOC_FL_KEEP_SIZE, cur_size_, max_size_ - cur_size_) != 0 && errno != EOPNOTSUPP)
                 {
-                    fclose(fs_); // 关闭当前文件
-                    fs_ = NULL;
+                    std::cout << __FILE__ << __LINE__ << "fallocate file " << filename_ << " failed" << std::endl;
+                    perror(NULL);
                 }
-                std::string filename = CreateFileName(); // 创建新的文件名
-                fs_ = fopen(filename.c_str(), "ab");
-                if (fs_ == NULL)
+            }
+        }
+
+        // 关闭当前文件，释放未用完的预留空间
+        void CloseFile()
+        {
+            if (fs_ == NULL)
+            {
+                return;
+            }
+            Sync(g_conf_data->flush_log == 3); // 组提交模式下关闭前落盘剩余数据
+            fflush(fs_);
+            struct stat st;
+            if (options_.preallocate && fstat(fileno(fs_), &st) == 0 && static_cast<size_t>(st.st_size) < max_size_)
+            {
+                // 截断到当前大小即释放文件末尾之后的预留块(按时间滚动的文件通常写不满)
+                if (ftruncate(fileno(fs_), st.st_size) != 0)
                 {
-                    // 打开文件失败时输出错误信息
-                    std::cout << __FILE__ << __LINE__ << "open file " << filename << " failed" << std::endl;
+                    std::cout << __FILE__ << __LINE__ << "truncate file " << filename_ << " failed" << std::endl;
                     perror(NULL);
                 }
-                cur_size_ = 0; // 重置当前文件大小
             }
+            fclose(fs_); // 关闭当前文件
+            fs_ = NULL;
+            index_.Close();
         }
 
-        // 创建新的日志文件名
+        // 创建新的日志文件名，同时确定按时间滚动的时刻
         std::string CreateFileName()
         {
-            time_t time_ = Util::Date::Now();
+            time_t now = Util::Date::Now();
+            UpdateClock(now);
+            roll_at_ = options_.period == RollPeriod::HOURLY ? hour_end_ : options_.period == RollPeriod::DAILY ? day_end_ : 0;
+            int sec = static_cast<int>(now - hour_start_);
+            char name[64];
+            snprintf(name, sizeof(name), "%s%02d%02d-%06zu.log", hour_prefix_, sec / 60, sec % 60, cnt_++ % 1000000);
+            return basename_ + name;
+        }
+
+        // 缓存当前小时的"YYYYMMDD-HH"和起止时间，每小时只调用一次localtime_r(夏令时切换发生在整点)
+        void UpdateClock(time_t now)
+        {
+            if (now >= hour_start_ && now < hour_end_)
+            {
+                return;
+            }
             struct tm t;
-            localtime_r(&time_, &t);
-            // 根据时间和计数器生成文件名
-            std::string filename = basename_ + std::to_string(t.tm_year + 1900) + std::to_string(t.tm_mon + 1) + std::to_string(t.tm_mday) + std::to_string(t.tm_hour + 1) + std::to_string(t.tm_min + 1) + std::to_string(t.tm_sec + 1) + "-" + std::to_string(cnt_++) + ".log";
-            return filename;
+            localtime_r(&now, &t);
+            snprintf(hour_prefix_, sizeof(hour_prefix_), "%04d%02d%02d-%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour);
+            hour_start_ = now - t.tm_min * 60 - t.tm_sec;
+            hour_end_ = hour_start_ + 3600;
+            t.tm_mday += 1; // 次日零点，由mktime处理跨月和夏令时
+            t.tm_hour = 0;
+            t.tm_min = 0;
+            t.tm_sec = 0;
+            t.tm_isdst = -1;
+            day_end_ = mktime(&t);
+        }
+
+        // 在线程池中删除超出保留策略的最旧文件；当前文件和刚提交压缩的文件closed计入总数但不删除
+        void EnforceRetention(const std::string &closed)
+        {
+            if (options_.max_files == 0 && options_.max_bytes == 0)
+            {
+                return;
+            }
+            std::string dir = Util::File::Path(basename_);
+            std::string prefix = basename_.substr(dir.size());
+            auto task = [dir = dir.empty() ? std::string("./") : dir, prefix, current = filename_.substr(dir.size()),
+                         closed = closed.substr(dir.size()), max_files = options_.max_files, max_bytes = options_.max_bytes]()
+            {
+                RemoveOldFiles(dir, prefix, current, closed, max_files, max_bytes);
+            };
+            try
+            {
+                ThreadPool::Background(g_conf_data->thread_count).post(task);
+            }
+            catch (const std::runtime_error &)
+            {
+                task(); // 线程池已关闭(进程退出中)，直接清理
+            }
+        }
+
+        static constexpr size_t kSegmentNameSize = 26; // CreateFileName生成的"YYYYMMDD-HHMMSS-NNNNNN.log"的长度
+
+        // name是否为prefix对应的滚动文件："prefix"+"YYYYMMDD-HHMMSS-NNNNNN.log"，压缩后再加".zst"或".lz4"
+        // 只按完整格式匹配，避免删除同目录下恰好同名开头的其他文件(如prefix为app时的app-audit.log、app2的滚动文件)
+        static bool IsSegment(const std::string &name, const std::string &prefix)
+        {
+            size_t n = prefix.size() + kSegmentNameSize;
+            if (name.size() != n && name.size() != n + 4)
+            {
+                return false;
+            }
+            if (name.compare(0, prefix.size(), prefix) != 0 || name.compare(n - 4, 4, ".log") != 0)
+            {
+                return false;
+            }
+            if (name.size() == n + 4 && name.compare(n, 4, ".zst") != 0 && name.compare(n, 4, ".lz4") != 0)
+            {
+                return false;
+            }
+            const char *p = name.c_str() + prefix.size();
+            for (size_t i = 0; i < kSegmentNameSize - 4; ++i)
+            {
+                bool dash = i == 8 || i == 15;
+                if (dash ? p[i] != '-' : (p[i] < '0' || p[i] > '9'))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static void RemoveOldFiles(const std::string &dir, const std::string &prefix, const std::string &current,
+                                   const std::string &closed, size_t max_files, size_t max_bytes)
+        {
+            std::vector<std::pair<std::string, size_t>> files; // 可删除的文件，按时间排序，压缩后的文件紧跟在原文件名之后
+            size_t count = 0;
+            size_t total = 0;
+            std::error_code error;
+            for (auto &entry : std::filesystem::directory_iterator(dir, error))
+            {
+                std::string name = entry.path().filename().string();
+                if (!IsSegment(name, prefix))
+                {
+                    continue;
+                }
+                std::error_code size_error;
+                size_t size = entry.file_size(size_error);
+                if (size_error)
+                {
+                    continue;
+                }
+                ++count;
+                total += size;
+                // 当前文件和刚提交压缩的文件(压缩完成前后分别为原文件名和原文件名加扩展名)只计数
+                if (name != current && (closed.empty() || name.compare(0, closed.size(), closed) != 0))
+                {
+                    files.emplace_back(std::move(name), size);
+                }
+            }
+            std::sort(files.begin(), files.end());
+            for (auto &f : files)
+            {
+                if ((max_files == 0 || count <= max_files) && (max_bytes == 0 || total <= max_bytes))
+                {
+                    break;
+                }
+                if (unlink((dir + f.first).c_str()) != 0 && errno != ENOENT)
+                {
+                    std::cout << __FILE__ << __LINE__ << "remove file " << dir + f.first << " failed" << std::endl;
+                    perror(NULL);
+                }
+                // 同时删除时间索引，压缩后的文件与原文件共用"原文件名.idx"
+                std::string segment = f.first.substr(0, prefix.size() + kSegmentNameSize);
+                unlink((dir + segment + ".idx").c_str());
+                --count;
+                total -= f.second;
+            }
         }
 
         size_t cnt_ = 1;           // 文件计数器
         size_t max_size_;          // 文件最大大小
         size_t cur_size_ = 0;      // 当前文件大小
         std::string basename_;     // 基础文件名
+        std::string filename_;     // 当前文件名
+        RollOptions options_;      // 滚动和保留策略
+        FILE *fs_ = NULL;          // 文件指针
+        GroupCommit commit_;       // 落盘策略
+        time_t roll_at_ = 0;       // 按时间滚动的时刻，0表示不按时间滚动
+        time_t hour_start_ = 0;    // 缓存的当前小时的起止时间
+        time_t hour_end_ = 0;
+        time_t day_end_ = 0;       // 缓存的次日零点
+        char hour_prefix_[16] = {0}; // 缓存的"YYYYMMDD-HH"
+        timeindex::Writer index_;  // 当前文件的时间索引，配置time_index时写入
+    };
+
+
+    // 以紧凑二进制格式(见BinaryFile.hpp)写文件的实现类，可用log_decoder还原为文本
+    // max_size为0时写入单个文件，否则写满后滚动到filename.1、filename.2...
+    class BinaryFileFlush : public LogFlush
+    {
+    public:
+        using ptr = std::shared_ptr<BinaryFileFlush>;
+        BinaryFileFlush(const std::string &filename, size_t max_size = 0) : filename_(filename), max_size_(max_size)
+        {
+            Util::File::CreateDirectory(Util::File::Path(filename));
+        }
+
+        ~BinaryFileFlush()
+        {
+            if (fs_ != NULL)
+            {
+                fclose(fs_);
+            }
+        }
+
+        bool AcceptsBinary() const override { return true; }
+
+        // 文本日志器的数据整体作为文本条目写入
+        void Flush(const char *data, size_t len) override
+        {
+            InitLogFile();
+            encoder_.EncodeText(out_, std::string_view(data, len));
+            Write();
+        }
+
+        void FlushBinary(std::string_view logger_name, const char *data, size_t len) override
+        {
+            InitLogFile();
+            BinaryRecord::View view;
+            while (len > 0)
+            {
+                size_t n = BinaryRecord::Decode(data, len, view);
+                if (n == 0)
+                {
+                    std::cout << __FILE__ << __LINE__ << "corrupted binary log record, " << len << " bytes dropped" << std::endl;
+                    break;
+                }
+                encoder_.EncodeRecord(out_, logger_name, view);
+                data += n;
+                len -= n;
+            }
+            Write();
+        }
+
+        void Sync(bool force) override
+        {
+            if (fs_ != NULL && commit_.Due(force))
+            {
+                commit_.Sync(force, [this]()
+                             { fflush(fs_); fsync(fileno(fs_)); });
+            }
+        }
+
+        const SyncStats *GetSyncStats() const override { return &commit_.Stats(); }
+
+    private:
+        // 打开(或滚动)文件，每次打开都开始新的字典会话
+        void InitLogFile()
+        {
+            if (fs_ != NULL && (max_size_ == 0 || cur_size_ < max_size_))
+            {
+                return;
+            }
+            if (fs_ != NULL)
+            {
+                Sync(g_conf_data->flush_log == 3);
+                fclose(fs_);
+            }
+            std::string filename = max_size_ == 0 ? filename_ : filename_ + "." + std::to_string(cnt_++);
+            fs_ = fopen(filename.c_str(), "ab");
+            if (fs_ == NULL)
+            {
+                std::cout << __FILE__ << __LINE__ << "open file " << filename << " failed" << std::endl;
+                perror(NULL);
+                return;
+            }
+            cur_size_ = ftell(fs_);
+            if (cur_size_ == 0)
+            {
+                out_.append(binfile::kMagic, sizeof(binfile::kMagic));
+                out_.push_back(static_cast<char>(binfile::kVersion));
+            }
+            encoder_.Reset(out_);
+        }
+
+        void Write()
+        {
+            if (fs_ == NULL)
+            {
+                out_.clear();
+                return;
+            }
+            fwrite(out_.data(), 1, out_.size(), fs_);
+            if (ferror(fs_))
+            {
+                std::cout << __FILE__ << __LINE__ << "write file " << filename_ << " failed" << std::endl;
+                perror(NULL);
+            }
+            cur_size_ += out_.size();
+            commit_.Written(out_.size());
+            out_.clear(); // 保留容量，稳定后不再分配
+            if (g_conf_data->flush_log == 1 || g_conf_data->flush_log == 3)
+            {
+                fflush(fs_);
+            }
+            Sync(false);
+        }
+
+
+        std::string filename_;     // 文件名
+        size_t max_size_;          // 单个文件最大大小，0表示不滚动
+        size_t cur_size_ = 0;      // 当前文件大小
+        size_t cnt_ = 1;           // 滚动文件计数器
         FILE *fs_ = NULL;          // 文件指针
+        std::string out_;          // 编码缓冲区
+        binfile::Encoder encoder_; // 当前文件的字典状态
+        GroupCommit commit_;       // 落盘策略
     };
 
+    // 通过内存映射追加写文件的实现类，不经过stdio缓冲，写入即进入页缓存，进程崩溃也不会丢失已写入的数据
+    // 文件按chunk_size整块预分配并只映射当前块，写满后映射下一块；max_size不为0时在超过它的第一个块边界滚动到filename.1、filename.2...
+    // flush_log为0时交给内核回写，为1时msync(MS_ASYNC)发起回写，为2时每批fdatasync等待落盘，为3时按组提交策略落盘
+    // 关闭时截掉预分配的空白部分；崩溃时文件末尾会留下未使用的'\0'，重新打开时从最后一个非'\0'字节之后继续追加
+    class MmapFileFlush : public LogFlush
+    {
+    public:
+        using ptr = std::shared_ptr<MmapFileFlush>;
+        MmapFileFlush(const std::string &filename, size_t chunk_size = 64 * 1024 * 1024, size_t max_size = 0)
+            : filename_(filename), chunk_size_(RoundToPage(chunk_size)), max_size_(max_size)
+        {
+            Util::File::CreateDirectory(Util::File::Path(filename));
+            Open(filename_);
+        }
+
+        ~MmapFileFlush()
+        {
+            Close();
+        }
+
+        void Flush(const char *data, size_t len) override
+        {
+            commit_.Written(len);
+            size_t synced = pos_;
+            while (len > 0)
+            {
+                if (map_ == NULL || pos_ == map_off_ + chunk_size_)
+                {
+                    WriteBack(synced);
+                    if (!NextChunk())
+                    {
+                        return;
+                    }
+                    synced = pos_;
+                }
+                size_t n = std::min(len, map_off_ + chunk_size_ - pos_);
+                memcpy(map_ + (pos_ - map_off_), data, n);
+                pos_ += n;
+                data += n;
+                len -= n;
+            }
+            WriteBack(synced);
+            Sync(false);
+        }
+
+        // fdatasync同时写回此前已解除映射的块中的脏页
+        void Sync(bool force) override
+        {
+            if (fd_ >= 0 && commit_.Due(force))
+            {
+                commit_.Sync(force, [this]()
+                             { fdatasync(fd_); });
+            }
+        }
+
+        const SyncStats *GetSyncStats() const override { return &commit_.Stats(); }
+
+    private:
+        static size_t RoundToPage(size_t n)
+        {
+            size_t page = sysconf(_SC_PAGESIZE);
+            return n < page ? page : (n + page - 1) / page * page;
+        }
+
+        // 打开文件并定位到已有数据的末尾
+        void Open(const std::string &filename)
+        {
+            fd_ = open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (fd_ < 0)
+            {
+                std::cout << __FILE__ << __LINE__ << "open file " << filename << " failed" << std::endl;
+                perror(NULL);
+                return;
+            }
+            struct stat st;
+            pos_ = fstat(fd_, &st) == 0 ? st.st_size : 0;
+            // 跳过上次崩溃时残留的预分配空白，只检查最后一块
+            char buf[4096];
+            size_t floor = pos_ > chunk_size_ ? pos_ - chunk_size_ : 0;
+            while (pos_ > floor)
+            {
+                size_t n = std::min(sizeof(buf), pos_ - floor);
+                if (pread(fd_, buf, n, pos_ - n) != static_cast<ssize_t>(n))
+                {
+                    break;
+                }
+                size_t i = n;
+                while (i > 0 && buf[i - 1] == '\0')
+                {
+                    --i;
+                }
+                pos_ -= n - i;
+                if (i > 0)
+                {
+                    break;
+                }
+            }
+            map_off_ = pos_ / chunk_size_ * chunk_size_;
+        }
+
+        // 截掉预分配的空白并关闭文件
+        void Close()
+        {
+            Sync(g_conf_data->flush_log >= 2);
+            if (map_ != NULL)
+            {
+                munmap(map_, chunk_size_);
+                map_ = NULL;
+            }
+            if (fd_ >= 0)
+            {
+                if (ftruncate(fd_, pos_) < 0)
+                {
+                    std::cout << __FILE__ << __LINE__ << "truncate file " << filename_ << " failed" << std::endl;
+                    perror(NULL);
+                }
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+
+        // 映射写入位置所在的块，必要时先滚动文件；块的磁盘空间预先分配，避免写入映射时因磁盘满触发SIGBUS
+        bool NextChunk()
+        {
+            if (map_ != NULL)
+            {
+                munmap(map_, chunk_size_);
+                map_ = NULL;
+                map_off_ += chunk_size_;
+            }
+            if (max_size_ != 0 && pos_ >= max_size_)
+            {
+                Close();
+                Open(filename_ + "." + std::to_string(cnt_++));
+            }
+            if (fd_ < 0)
+            {
+                return false;
+            }
+            int err = posix_fallocate(fd_, map_off_, chunk_size_);
+            if (err != 0)
+            {
+                std::cout << __FILE__ << __LINE__ << "allocate file " << filename_ << " failed: " << strerror(err) << std::endl;
+                return false;
+            }
+            void *p = mmap(NULL, chunk_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, map_off_);
+            if (p == MAP_FAILED)
+            {
+                std::cout << __FILE__ << __LINE__ << "mmap file " << filename_ << " failed" << std::endl;
+                perror(NULL);
+                return false;
+            }
+            map_ = static_cast<char *>(p);
+            return true;
+        }
+
+        // flush_log为1时对当前块中[from, pos_)所在的页发起异步回写
+        void WriteBack(size_t from)
+        {
+            if (map_ == NULL || g_conf_data->flush_log != 1 || from >= pos_)
+            {
+                return;
+            }
+            size_t page = sysconf(_SC_PAGESIZE);
+            size_t begin = (std::max(from, map_off_) - map_off_) / page * page;
+            if (msync(map_ + begin, pos_ - map_off_ - begin, MS_ASYNC) < 0)
+            {
+                std::cout << __FILE__ << __LINE__ << "msync file " << filename_ << " failed" << std::endl;
+                perror(NULL);
+            }
+        }
+
+        std::string filename_;   // 文件名
+        size_t chunk_size_;      // 每次预分配和映射的大小(页对齐)
+        size_t max_size_;        // 单个文件最大大小，0表示不滚动
+        size_t cnt_ = 1;         // 滚动文件计数器
+        int fd_ = -1;            // 文件描述符
+        char *map_ = NULL;       // 当前块的映射地址
+        size_t map_off_ = 0;     // 当前块在文件中的偏移
+        size_t pos_ = 0;         // 下一次写入的文件偏移
+        GroupCommit commit_;     // 落盘策略
+    };
 
     // 日志刷新工厂类，用于创建不同类型的日志刷新对象
     class LogFlushFactory
@@ -1,9 +1,14 @@
 #pragma once
+#include <atomic>
 #include <unordered_map>
+#include <vector>
 #include "AsyncLogger.hpp"
 
 namespace mylog
 {
+    // 日志器名到日志器的映射，发布后只读不再修改
+    using LoggerMap = std::unordered_map<std::string, AsyncLogger::ptr>;
+
     //日志器管理类 - 单例模式(懒汉模式 - 静态局部变量)
     class LoggerManager
     {
@@ -20,35 +25,63 @@ namespace mylog
         // 检查指定名称的日志器是否存在
         bool LoggerExist(const std::string &name)
         {
-            std::unique_lock<std::mutex> lock(mutex);
-            return loggers_.find(name) == loggers_.end();
+            return FindLogger(name) != nullptr;
         }
 
-        // 添加一个日志器
+        // 添加一个日志器：复制当前映射表、插入后整体发布新的映射表，写者之间用mutex互斥
+        // 旧映射表不释放(读者可能仍在访问)，到LoggerManager析构时统一释放；日志器数量少且很少添加，额外内存可以忽略
         void AddLogger(const AsyncLogger::ptr &&AsyncLoggerPtr)
         {
-            if (LoggerExist(AsyncLoggerPtr->Name()))
+            std::unique_lock<std::mutex> lock(mutex);
+            const LoggerMap *cur = loggers_.load(std::memory_order_relaxed);
+            if (cur->count(AsyncLoggerPtr->Name()) != 0)
             {
                 return;
             }
-            std::unique_lock<std::mutex> lock(mutex);
-            loggers_.insert(std::make_pair(AsyncLoggerPtr->Name(), AsyncLoggerPtr));
+            std::unique_ptr<LoggerMap> next(new LoggerMap(*cur));
+            next->insert(std::make_pair(AsyncLoggerPtr->Name(), AsyncLoggerPtr));
+            Publish(std::move(next));
         }
 
-        // 获取指定名称的日志器
+        // 获取指定名称的日志器，不加锁
         AsyncLogger::ptr GetLogger(const std::string& name)
         {
-            std::unique_lock<std::mutex> lock(mutex);
-            auto it = loggers_.find(name);
-            if (it == loggers_.end())
+            const AsyncLogger::ptr *logger = FindLogger(name);
+            return logger == nullptr ? AsyncLogger::ptr() : *logger;
+        }
+
+        // 查找指定名称的日志器，不存在时返回nullptr
+        // 只做一次原子读取加一次哈希查找；日志器添加后不会被移除，返回的指针在LoggerManager的生命周期内一直有效
+        const AsyncLogger::ptr *FindLogger(const std::string &name) const
+        {
+            const LoggerMap *cur = loggers_.load(std::memory_order_acquire);
+            auto it = cur->find(name);
+            return it == cur->end() ? nullptr : &it->second;
+        }
+
+        // 设置指定日志器的最低输出级别，日志器不存在时返回false
+        bool SetLevel(const std::string &name, LogLevel::value level)
+        {
+            AsyncLogger::ptr logger = GetLogger(name);
+            if (!logger)
+            {
+                return false;
+            }
+            logger->SetLevel(level);
+            return true;
+        }
+
+        // 设置所有日志器的最低输出级别
+        void SetAllLevel(LogLevel::value level)
+        {
+            for (auto &it : *loggers_.load(std::memory_order_acquire))
             {
-                return AsyncLogger::ptr();
+                it.second->SetLevel(level);
             }
-            return it->second;
         }
 
         // 获取默认日志器
-        AsyncLogger::ptr DefaultLogger()
+        const AsyncLogger::ptr &DefaultLogger() const
         {
             return default_logger_;
         }
@@ -60,18 +93,62 @@ namespace mylog
             std::unique_ptr<LoggerBuilder> builder(new LoggerBuilder());
             builder->BuildLoggerName("default");
             default_logger_ = builder->Build();
-            loggers_.insert(std::make_pair("default", default_logger_));
+            std::unique_ptr<LoggerMap> loggers(new LoggerMap());
+            loggers->insert(std::make_pair("default", default_logger_));
+            Publish(std::move(loggers));
         }
 
         ~LoggerManager() = default;
+
+        // 发布新的映射表，调用者持有mutex(构造函数除外)
+        void Publish(std::unique_ptr<LoggerMap> &&loggers)
+        {
+            loggers_.store(loggers.get(), std::memory_order_release);
+            snapshots_.push_back(std::move(loggers));
+        }
+
         LoggerManager(const LoggerManager &) = delete;            // 禁止拷贝构造
         LoggerManager &operator=(const LoggerManager &) = delete; // 禁止拷贝赋值
         LoggerManager(LoggerManager &&) = delete;                 // 禁止移动构造
         LoggerManager &operator=(LoggerManager &&) = delete;      // 禁止移动赋值
 
     private:
-        std::mutex mutex; // 互斥锁，用于线程安全,互斥访问loggers_
+        std::mutex mutex; // 互斥锁，用于AddLogger之间互斥，读取不加锁
         AsyncLogger::ptr default_logger_; // 默认日志器
-        std::unordered_map<std::string, AsyncLogger::ptr> loggers_; // 存储所有日志器的映射表
+        std::atomic<const LoggerMap *> loggers_{nullptr}; // 当前发布的映射表
+        std::vector<std::unique_ptr<const LoggerMap>> snapshots_; // 发布过的所有映射表，析构时释放
+    };
+
+    // 日志器句柄：按名字查找一次后缓存结果，之后每次使用只需一次原子读取
+    // 日志器添加后不会被替换或移除，查到的结果永远有效；未查到时下次使用会重新查找
+    class LoggerHandle
+    {
+    public:
+        explicit LoggerHandle(const std::string &name) : name_(name) {}
+
+        // 获取日志器，不存在时返回空指针
+        const AsyncLogger::ptr &Get()
+        {
+            const AsyncLogger::ptr *logger = logger_.load(std::memory_order_acquire);
+            if (logger == nullptr)
+            {
+                logger = LoggerManager::GetInstance().FindLogger(name_);
+                if (logger == nullptr)
+                {
+                    static const AsyncLogger::ptr null_logger;
+                    return null_logger;
+                }
+                logger_.store(logger, std::memory_order_release);
+            }
+            return *logger;
+        }
+
+        AsyncLogger *operator->() { return Get().get(); }
+
+        explicit operator bool() { return Get() != nullptr; }
+
+    private:
+        std::string name_;
+        std::atomic<const AsyncLogger::ptr *> logger_{nullptr};
     };
-}
\ No newline at end of file
+}
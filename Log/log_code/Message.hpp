@@ -1,12 +1,79 @@
 #pragma once
 #include <thread>
+#include <pthread.h>
 #include <memory>
 #include <sstream>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
 #include "Level.hpp"
 #include "Util.hpp"
 
 namespace mylog
 {
+    // 按snprintf语义向定长内存写入一行日志：空间不足时只写入能容纳的部分，但长度照常累计，
+    // 调用方可根据Length()判断是否写完整，并按返回的长度重新申请空间
+    class LineWriter
+    {
+    public:
+        LineWriter(char *dst, size_t cap) : dst_(dst), cap_(cap), len_(0) {}
+
+        void Append(const char *data, size_t len)
+        {
+            if (len_ < cap_)
+            {
+                memcpy(dst_ + len_, data, std::min(len, cap_ - len_));
+            }
+            len_ += len;
+        }
+
+        void Append(const char *str) { Append(str, strlen(str)); }
+
+        void Append(std::string_view str) { Append(str.data(), str.size()); }
+
+        void Append(char c) { Append(&c, 1); }
+
+        void AppendUInt(uint64_t v)
+        {
+            char buf[20];
+            int i = sizeof(buf);
+            do
+            {
+                buf[--i] = '0' + v % 10;
+                v /= 10;
+            } while (v);
+            Append(buf + i, sizeof(buf) - i);
+        }
+
+        // 按printf格式写入，va不会被消耗
+        void VPrintf(const char *format, va_list va)
+        {
+            va_list cp;
+            va_copy(cp, va);
+            size_t room = len_ < cap_ ? cap_ - len_ : 0;
+            int n = vsnprintf(room ? dst_ + len_ : nullptr, room, format, cp);
+            va_end(cp);
+            if (n < 0)
+            {
+                perror("vsnprintf failed!!");
+                return;
+            }
+            len_ += n;
+        }
+
+        // 已写入(或需要)的总长度
+        size_t Length() const { return len_; }
+
+        // 是否完整写入
+        bool Fits() const { return len_ <= cap_; }
+
+    private:
+        char *dst_;
+        size_t cap_;
+        size_t len_;
+    };
+
     class LogMessage
     {
     public:
@@ -17,26 +84,74 @@ namespace mylog
 
         // 带参数的构造函数，用于初始化日志消息
         LogMessage(const std::string file, size_t line, LogLevel::value level, std::string name, std::string payload)
-            : line_(line), ctime_(Util::Date::Now()), file_name_(file), name_(name), payload_(payload), tid_(std::this_thread::get_id()), level_(level)
+            : line_(line), ctime_ns_(Util::Date::NowNs()), ctime_(ctime_ns_ / 1000000000), file_name_(file), name_(name), payload_(payload), tid_(std::this_thread::get_id()), level_(level)
         {
         }
 
         // 格式化日志消息为字符串
         std::string format()
         {
-            std::stringstream ret;
-            struct tm t;
-            localtime_r(&ctime_, &t); // 将时间转换为本地时间
-            char buf[128];
-            strftime(buf, sizeof(buf), "%H:%M:%S", &t); // 格式化时间为时:分:秒
-            std::string tmp1 = '[' + std::string(buf) + "][";
-            std::string tmp2 = '[' + std::string(LogLevel::ToString(level_)) + "][" + name_ + "][" + file_name_ + ":" + std::to_string(line_) + "]\t" + payload_ + "\n";
-            ret << tmp1 << tid_ << tmp2; // 拼接线程ID和日志信息
-            return ret.str();
+            std::ostringstream tid;
+            tid << tid_;
+            LineWriter count(nullptr, 0); // 先计算长度，再一次性写入
+            FormatTo(count, tid.str());
+            std::string ret(count.Length(), '\0');
+            LineWriter w(&ret[0], ret.size());
+            FormatTo(w, tid.str());
+            return ret;
+        }
+
+        // 写入日志头: [时:分:秒.微秒][线程ID][级别][日志器名][文件:行号]\t
+        static void FormatHeader(LineWriter &w, int64_t ctime_ns, std::string_view tid, LogLevel::value level,
+                                 std::string_view name, const char *file, size_t line)
+        {
+            char buf[Util::Date::kTimeLen];
+            size_t n = Util::Date::FormatTime(ctime_ns, buf);
+            w.Append('[');
+            w.Append(buf, n);
+            w.Append("][", 2);
+            w.Append(tid);
+            w.Append("][", 2);
+            w.Append(LogLevel::ToString(level));
+            w.Append("][", 2);
+            w.Append(name);
+            w.Append("][", 2);
+            w.Append(file);
+            w.Append(':');
+            w.AppendUInt(line);
+            w.Append("]\t", 2);
+        }
+
+        // 当前线程ID的字符串形式，每个线程只格式化一次
+        static const std::string &ThreadIdString()
+        {
+            static thread_local std::string tid = []()
+            {
+                std::ostringstream ss;
+                ss << std::this_thread::get_id();
+                return ss.str();
+            }();
+            return tid;
+        }
+
+        // 当前线程ID的数值形式，与std::thread::id的输出一致
+        static uint64_t ThreadIdNumber()
+        {
+            static thread_local uint64_t tid = static_cast<uint64_t>(pthread_self());
+            return tid;
+        }
+
+    private:
+        void FormatTo(LineWriter &w, const std::string &tid)
+        {
+            FormatHeader(w, ctime_ns_, tid, level_, name_, file_name_.c_str(), line_);
+            w.Append(payload_);
+            w.Append('\n');
         }
 
     public:
         size_t line_;           // 行号
+        int64_t ctime_ns_;      // 时间戳(纳秒)
         time_t ctime_;          // 时间戳
         std::string file_name_; // 文件名
         std::string name_;      // 日志器名称
@@ -9,23 +9,111 @@ namespace mylog
     }
 
     // 用户获取默认日志器
-    AsyncLogger::ptr DefaultLogger()
+    const AsyncLogger::ptr &DefaultLogger()
     {
         return LoggerManager::GetInstance().DefaultLogger();
     }
 
-// 简化用户使用，宏函数默认填上文件吗+行号
-#define Debug(fmt, ...) Debug(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
-#define Info(fmt, ...) Info(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
-#define Warn(fmt, ...) Warn(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
-#define Error(fmt, ...) Error(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
-#define Fatal(fmt, ...) Fatal(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
+// 编译期日志级别：低于MYLOG_ACTIVE_LEVEL的日志宏展开为空操作，参数不会被求值
+#define MYLOG_LEVEL_DEBUG 0
+#define MYLOG_LEVEL_INFO 1
+#define MYLOG_LEVEL_WARN 2
+#define MYLOG_LEVEL_ERROR 3
+#define MYLOG_LEVEL_FATAL 4
+#define MYLOG_LEVEL_OFF 5
+#ifndef MYLOG_ACTIVE_LEVEL
+#define MYLOG_ACTIVE_LEVEL MYLOG_LEVEL_DEBUG
+#endif
 
-// 无需获取日志器，默认标准输出
+// 按名字获取日志器的句柄，每个调用点只查找一次，之后只需一次原子读取，如MYLOG_LOGGER("name")->Info("...")
+#define MYLOG_LOGGER(name) ([]() -> mylog::LoggerHandle & {       \
+        static mylog::LoggerHandle handle(name);                 \
+        return handle; }())
+
+// {}风格的格式串：C++20下在编译期检查；C++17下为每个调用点缓存运行期解析的结果，格式串须为字符串字面量
+#if __cplusplus >= 202002L
+#define MYLOG_FORMAT(str) str
+#else
+#define MYLOG_FORMAT(str) ([]() -> mylog::fmt::FormatSite & { \
+        static mylog::fmt::FormatSite site(str);              \
+        return site; }())
+#endif
+
+// 简化用户使用，宏函数默认填上文件吗+行号；{}风格的类型安全接口为*Fmt
+// 二进制接口*Bin：每个调用点的静态信息只注册一次，参数在后台线程格式化
+// 默认日志器版本LOG*DEFAULT无需获取日志器，默认标准输出
+#define MYLOG_BINARY(level, fmt, ...) LogBinary([]() -> const mylog::CallSite & {                 \
+        static const mylog::CallSite site(__FILE__, __LINE__, mylog::LogLevel::value::level, fmt); \
+        return site; }, MYLOG_FORMAT(fmt), ##__VA_ARGS__)
+
+#if MYLOG_ACTIVE_LEVEL <= MYLOG_LEVEL_DEBUG
+#define Debug(fmt, ...) Debug(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
+#define DebugFmt(fmt, ...) DebugFmt(__FILE__, __LINE__, MYLOG_FORMAT(fmt), ##__VA_ARGS__)
+#define DebugBin(fmt, ...) MYLOG_BINARY(DEBUG, fmt, ##__VA_ARGS__)
 #define LOGDEBUGDEFAULT(fmt, ...) mylog::DefaultLogger()->Debug(fmt, ##__VA_ARGS__)
+#define LOGDEBUGFMTDEFAULT(fmt, ...) mylog::DefaultLogger()->DebugFmt(fmt, ##__VA_ARGS__)
+#else
+#define Debug(fmt, ...) NoLog()
+#define DebugFmt(fmt, ...) NoLog()
+#define DebugBin(fmt, ...) NoLog()
+#define LOGDEBUGDEFAULT(fmt, ...) ((void)0)
+#define LOGDEBUGFMTDEFAULT(fmt, ...) ((void)0)
+#endif
+
+#if MYLOG_ACTIVE_LEVEL <= MYLOG_LEVEL_INFO
+#define Info(fmt, ...) Info(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
+#define InfoFmt(fmt, ...) InfoFmt(__FILE__, __LINE__, MYLOG_FORMAT(fmt), ##__VA_ARGS__)
+#define InfoBin(fmt, ...) MYLOG_BINARY(INFO, fmt, ##__VA_ARGS__)
 #define LOGINFODEFAULT(fmt, ...) mylog::DefaultLogger()->Info(fmt, ##__VA_ARGS__)
+#define LOGINFOFMTDEFAULT(fmt, ...) mylog::DefaultLogger()->InfoFmt(fmt, ##__VA_ARGS__)
+#else
+#define Info(fmt, ...) NoLog()
+#define InfoFmt(fmt, ...) NoLog()
+#define InfoBin(fmt, ...) NoLog()
+#define LOGINFODEFAULT(fmt, ...) ((void)0)
+#define LOGINFOFMTDEFAULT(fmt, ...) ((void)0)
+#endif
+
+#if MYLOG_ACTIVE_LEVEL <= MYLOG_LEVEL_WARN
+#define Warn(fmt, ...) Warn(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
+#define WarnFmt(fmt, ...) WarnFmt(__FILE__, __LINE__, MYLOG_FORMAT(fmt), ##__VA_ARGS__)
+#define WarnBin(fmt, ...) MYLOG_BINARY(WARN, fmt, ##__VA_ARGS__)
 #define LOGWARNDEFAULT(fmt, ...) mylog::DefaultLogger()->Warn(fmt, ##__VA_ARGS__)
+#define LOGWARNFMTDEFAULT(fmt, ...) mylog::DefaultLogger()->WarnFmt(fmt, ##__VA_ARGS__)
+#else
+#define Warn(fmt, ...) NoLog()
+#define WarnFmt(fmt, ...) NoLog()
+#define WarnBin(fmt, ...) NoLog()
+#define LOGWARNDEFAULT(fmt, ...) ((void)0)
+#define LOGWARNFMTDEFAULT(fmt, ...) ((void)0)
+#endif
+
+#if MYLOG_ACTIVE_LEVEL <= MYLOG_LEVEL_ERROR
+#define Error(fmt, ...) Error(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
+#define ErrorFmt(fmt, ...) ErrorFmt(__FILE__, __LINE__, MYLOG_FORMAT(fmt), ##__VA_ARGS__)
+#define ErrorBin(fmt, ...) MYLOG_BINARY(ERROR, fmt, ##__VA_ARGS__)
 #define LOGERRORDEFAULT(fmt, ...) mylog::DefaultLogger()->Error(fmt, ##__VA_ARGS__)
+#define LOGERRORFMTDEFAULT(fmt, ...) mylog::DefaultLogger()->ErrorFmt(fmt, ##__VA_ARGS__)
+#else
+#define Error(fmt, ...) NoLog()
+#define ErrorFmt(fmt, ...) NoLog()
+#define ErrorBin(fmt, ...) NoLog()
+#define LOGERRORDEFAULT(fmt, ...) ((void)0)
+#define LOGERRORFMTDEFAULT(fmt, ...) ((void)0)
+#endif
+
+#if MYLOG_ACTIVE_LEVEL <= MYLOG_LEVEL_FATAL
+#define Fatal(fmt, ...) Fatal(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
+#define FatalFmt(fmt, ...) FatalFmt(__FILE__, __LINE__, MYLOG_FORMAT(fmt), ##__VA_ARGS__)
+#define FatalBin(fmt, ...) MYLOG_BINARY(FATAL, fmt, ##__VA_ARGS__)
 #define LOGFATALDEFAULT(fmt, ...) mylog::DefaultLogger()->Fatal(fmt, ##__VA_ARGS__)
+#define LOGFATALFMTDEFAULT(fmt, ...) mylog::DefaultLogger()->FatalFmt(fmt, ##__VA_ARGS__)
+#else
+#define Fatal(fmt, ...) NoLog()
+#define FatalFmt(fmt, ...) NoLog()
+#define FatalBin(fmt, ...) NoLog()
+#define LOGFATALDEFAULT(fmt, ...) ((void)0)
+#define LOGFATALFMTDEFAULT(fmt, ...) ((void)0)
+#endif
 
 } // namespace mylog
\ No newline at end of file
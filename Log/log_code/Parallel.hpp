@@ -0,0 +1,324 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ThreadPool.hpp"
+
+// 基于ThreadPool的数据并行原语：parallel_for、parallel_reduce和有界流水线pipeline
+// 调用线程也参与计算；在线程池的线程中调用时一边等待一边执行队列中的任务，可以嵌套使用
+namespace mylog
+{
+    namespace detail
+    {
+        // 自适应分块：剩余量越少块越小(guided调度)，前期块大减少争用，后期块小平衡负载，块不小于grain
+        class ChunkCounter
+        {
+        public:
+            ChunkCounter(size_t n, size_t participants, size_t grain)
+                : n_(n), participants_(participants), grain_(grain) {}
+
+            // 领取下一块[first, last)，没有剩余时返回false
+            bool Claim(size_t &first, size_t &last)
+            {
+                size_t cur = next_.load(std::memory_order_relaxed);
+                while (cur < n_)
+                {
+                    size_t remaining = n_ - cur;
+                    size_t chunk = std::min(remaining, std::max(grain_, remaining / (2 * participants_)));
+                    if (next_.compare_exchange_weak(cur, cur + chunk, std::memory_order_relaxed))
+                    {
+                        first = cur;
+                        last = cur + chunk;
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // 出错后放弃剩余的块
+            void Cancel()
+            {
+                next_.store(n_, std::memory_order_relaxed);
+            }
+
+        private:
+            size_t n_;
+            size_t participants_;
+            size_t grain_;
+            std::atomic<size_t> next_{0};
+        };
+
+        // 参与者数量：不超过线程数+1(调用线程)，也不超过块数
+        inline size_t Participants(ThreadPool &pool, size_t n, size_t grain)
+        {
+            size_t chunks = (n + grain - 1) / grain;
+            return std::max<size_t>(1, std::min(pool.size() + 1, chunks));
+        }
+
+        // 未指定grain时按每个参与者约64块估算
+        inline size_t DefaultGrain(ThreadPool &pool, size_t n)
+        {
+            return std::max<size_t>(1, n / ((pool.size() + 1) * 64));
+        }
+
+        // 启动participants-1个任务并让调用线程作为第0个参与者，全部完成后返回，有异常时重新抛出第一个
+        template <typename Body>
+        void RunParticipants(ThreadPool &pool, size_t participants, ChunkCounter &counter, Body &body)
+        {
+            TaskGroup group;
+            auto task = [&body, &counter](size_t id)
+            {
+                try
+                {
+                    body(id);
+                }
+                catch (...)
+                {
+                    counter.Cancel();
+                    throw; // 由enqueue_bulk的包装记录到group
+                }
+            };
+            std::vector<std::function<void()>> tasks;
+            tasks.reserve(participants - 1);
+            for (size_t id = 1; id < participants; ++id)
+            {
+                tasks.emplace_back([task, id]() { task(id); });
+            }
+            pool.enqueue_bulk(group, tasks.begin(), tasks.end());
+            try
+            {
+                task(0);
+            }
+            catch (...)
+            {
+                group.fail(std::current_exception());
+            }
+            pool.wait(group);
+        }
+
+        template <typename T>
+        struct IsOptional : std::false_type
+        {
+        };
+
+        template <typename T>
+        struct IsOptional<std::optional<T>> : std::true_type
+        {
+        };
+
+        // 依次执行第I到第Last-1级，返回值为std::optional的一级可以过滤掉该项
+        template <size_t I, size_t Last, typename Stages, typename T>
+        auto RunStages(Stages &stages, T &&value)
+        {
+            if constexpr (I == Last)
+            {
+                return std::optional<std::decay_t<T>>(std::forward<T>(value));
+            }
+            else
+            {
+                auto result = std::get<I>(stages)(std::forward<T>(value));
+                if constexpr (IsOptional<decltype(result)>::value)
+                {
+                    using Next = decltype(RunStages<I + 1, Last>(stages, std::move(*result)));
+                    if (!result)
+                    {
+                        return Next();
+                    }
+                    return RunStages<I + 1, Last>(stages, std::move(*result));
+                }
+                else
+                {
+                    return RunStages<I + 1, Last>(stages, std::move(result));
+                }
+            }
+        }
+    }
+
+    // 对[first, last)并行调用body(i)，grain为每块的最小元素数，0表示自动选择
+    template <typename Index, typename Body>
+    void parallel_for(ThreadPool &pool, Index first, Index last, Body body, size_t grain = 0)
+    {
+        static_assert(std::is_integral<Index>::value, "parallel_for requires an integral index");
+        if (last <= first)
+        {
+            return;
+        }
+        size_t n = static_cast<size_t>(last - first);
+        grain = grain != 0 ? grain : detail::DefaultGrain(pool, n);
+        size_t participants = detail::Participants(pool, n, grain);
+        detail::ChunkCounter counter(n, participants, grain);
+        auto run = [&](size_t)
+        {
+            size_t b, e;
+            while (counter.Claim(b, e))
+            {
+                for (size_t i = b; i < e; ++i)
+                {
+                    body(static_cast<Index>(first + i));
+                }
+            }
+        };
+        detail::RunParticipants(pool, participants, counter, run);
+    }
+
+    // 并行归约：map(b, e, acc)把[b, e)累加到acc并返回，reduce(a, b)合并两个部分结果
+    // 每个参与者从identity开始累加自己领到的块，最后按参与者顺序合并，reduce需满足结合律和交换律
+    template <typename Index, typename T, typename Map, typename Reduce>
+    T parallel_reduce(ThreadPool &pool, Index first, Index last, T identity, Map map, Reduce reduce, size_t grain = 0)
+    {
+        static_assert(std::is_integral<Index>::value, "parallel_reduce requires an integral index");
+        if (last <= first)
+        {
+            return identity;
+        }
+        size_t n = static_cast<size_t>(last - first);
+        grain = grain != 0 ? grain : detail::DefaultGrain(pool, n);
+        size_t participants = detail::Participants(pool, n, grain);
+        detail::ChunkCounter counter(n, participants, grain);
+        std::vector<T> partial(participants, identity);
+        auto run = [&](size_t id)
+        {
+            size_t b, e;
+            while (counter.Claim(b, e))
+            {
+                partial[id] = map(static_cast<Index>(first + b), static_cast<Index>(first + e), std::move(partial[id]));
+            }
+        };
+        detail::RunParticipants(pool, participants, counter, run);
+        T result = std::move(partial[0]);
+        for (size_t i = 1; i < participants; ++i)
+        {
+            result = reduce(std::move(result), std::move(partial[i]));
+        }
+        return result;
+    }
+
+    // 有界流水线：source()在调用线程中依次产生std::optional<T>，返回空时结束；
+    // 中间各级在线程池中并行执行，某级返回std::optional时可以过滤掉该项；最后一级sink按source产生的顺序串行执行
+    // 同时在处理中的项不超过capacity，慢的sink会反压source；返回交给sink的项数，有异常时在全部项结束后重新抛出第一个
+    // 用法：pipeline(pool, 64, read_line, parse, filter, write)
+    template <typename Source, typename... Fns>
+    size_t pipeline(ThreadPool &pool, size_t capacity, Source source, Fns... fns)
+    {
+        static_assert(sizeof...(Fns) >= 1, "pipeline requires at least a sink");
+        constexpr size_t kLast = sizeof...(Fns) - 1;
+        using Item = typename std::decay_t<decltype(source())>::value_type;
+        using Result = decltype(detail::RunStages<0, kLast>(std::declval<std::tuple<Fns...> &>(), std::declval<Item>()));
+
+        std::tuple<Fns...> stages(std::move(fns)...);
+        auto &sink = std::get<kLast>(stages);
+        capacity = std::max<size_t>(1, capacity);
+
+        std::mutex mutex;
+        std::condition_variable space;     // 有项处理完时通知source
+        std::map<size_t, Result> ready;    // 已完成中间各级、等待按序交给sink的项
+        size_t next = 0;                   // 下一个交给sink的序号
+        bool draining = false;             // 是否有线程正在按序执行sink
+        size_t in_flight = 0;              // 处理中的项数
+        size_t delivered = 0;
+        TaskGroup group;
+
+        // 中间各级完成后放入重排区，由一个线程把连续的项依次交给sink
+        auto complete = [&](size_t seq, Result result)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.emplace(seq, std::move(result));
+            if (draining)
+            {
+                return;
+            }
+            draining = true;
+            while (!ready.empty() && ready.begin()->first == next)
+            {
+                Result value = std::move(ready.begin()->second);
+                ready.erase(ready.begin());
+                lock.unlock();
+                if (value)
+                {
+                    try
+                    {
+                        sink(std::move(*value));
+                        ++delivered; // 只有持有draining的线程修改
+                    }
+                    catch (...)
+                    {
+                        group.fail(std::current_exception());
+                    }
+                }
+                lock.lock();
+                ++next;
+                --in_flight;
+                space.notify_all();
+            }
+            draining = false;
+        };
+
+        size_t seq = 0;
+        while (true)
+        {
+            std::optional<Item> item;
+            try
+            {
+                item = source();
+            }
+            catch (...)
+            {
+                group.fail(std::current_exception());
+            }
+            if (!item)
+            {
+                break;
+            }
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (in_flight >= capacity)
+                {
+                    // 等待空位时帮忙执行任务，避免在线程池线程中调用时占住线程
+                    lock.unlock();
+                    bool ran = pool.run_one();
+                    lock.lock();
+                    if (!ran && in_flight >= capacity)
+                    {
+                        space.wait_for(lock, std::chrono::milliseconds(1));
+                    }
+                }
+                ++in_flight;
+            }
+            group.add();
+            try
+            {
+                pool.post([&, s = seq++, value = std::move(*item)]() mutable
+                          {
+                              Result result;
+                              try
+                              {
+                                  result = detail::RunStages<0, kLast>(stages, std::move(value));
+                              }
+                              catch (...)
+                              {
+                                  group.fail(std::current_exception());
+                              }
+                              complete(s, std::move(result));
+                              group.done();
+                          });
+            }
+            catch (...)
+            {
+                // 线程池已关闭，任务未提交：撤销计数，等待已提交的项后重新抛出
+                group.fail(std::current_exception());
+                group.done();
+                break;
+            }
+        }
+        pool.wait(group);
+        return delivered;
+    }
+}
@@ -0,0 +1,258 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "LogFlush.hpp"
+
+namespace mylog
+{
+    // 输出队列满时的处理方式
+    enum class SinkOverflow
+    {
+        BLOCK,       // 等待队列腾出空间，超时后丢弃新批次
+        DROP_NEWEST, // 丢弃新批次
+        DROP_OLDEST  // 丢弃队列中最早的批次
+    };
+
+    // 输出队列统计
+    struct QueueStats
+    {
+        std::atomic<uint64_t> batches{0};       // 入队的批次数
+        std::atomic<uint64_t> dropped{0};       // 丢弃的批次数
+        std::atomic<uint64_t> dropped_bytes{0}; // 丢弃的字节数
+        std::atomic<uint64_t> blocked{0};       // 因队列满而等待的次数
+        std::atomic<uint64_t> blocked_ns{0};    // 累计等待时间(纳秒)
+    };
+
+    // 为一个输出方式提供独立的写入线程和有界队列(装饰器模式)，与其他输出方式共享同一份批次缓冲区
+    // 慢的或卡住的输出方式只会积压、丢弃自己的数据，不会拖慢其他输出方式和异步工作器
+    class QueuedFlush : public LogFlush
+    {
+    public:
+        using ptr = std::shared_ptr<QueuedFlush>;
+        QueuedFlush(const LogFlush::ptr &flush, size_t max_bytes = 64 * 1024 * 1024,
+                    SinkOverflow overflow = SinkOverflow::BLOCK,
+                    std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
+            : flush_(flush), max_bytes_(max_bytes), overflow_(overflow), timeout_(timeout)
+        {
+            if (g_conf_data->flush_log == 3 && g_conf_data->sync_interval != 0)
+            {
+                tick_ = std::chrono::milliseconds(g_conf_data->sync_interval);
+            }
+            thread_ = std::thread(&QueuedFlush::ThreadEntry, this);
+        }
+
+        ~QueuedFlush()
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            thread_.join(); // 写完队列中剩余的数据后退出
+        }
+
+        bool AcceptsBinary() const override { return flush_->AcceptsBinary(); }
+
+        bool Queued() const override { return true; }
+
+        void FlushBatch(const Batch &batch) override
+        {
+            Enqueue(batch);
+        }
+
+        // 不经过共享批次直接调用时拷贝一份
+        void Flush(const char *data, size_t len) override
+        {
+            Enqueue(Copy(data, len, false, std::string_view()));
+        }
+
+        void FlushBinary(std::string_view logger_name, const char *data, size_t len) override
+        {
+            Enqueue(Copy(data, len, true, logger_name));
+        }
+
+        // 强制落盘时在队列中插入落盘标记，最多等待timeout，避免卡住的输出方式拖住异步工作器
+        void Sync(bool force) override
+        {
+            if (!force)
+            {
+                return; // 按策略的落盘由写入线程自己完成
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            uint64_t marker = ++markers_;
+            queue_.push_back(Item{Batch(), marker});
+            cv_.notify_one();
+            cv_idle_.wait_for(lock, timeout_, [this, marker]()
+                              { return synced_ >= marker; });
+        }
+
+        // 等待队列中的数据全部写完
+        void Wait() override
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_idle_.wait(lock, [this]()
+                          { return queue_.empty() && !busy_; });
+        }
+
+        const SyncStats *GetSyncStats() const override { return flush_->GetSyncStats(); }
+
+        const QueueStats &Stats() const { return stats_; }
+
+    private:
+        struct Item
+        {
+            Batch batch;
+            uint64_t marker; // 不为0时是落盘标记
+        };
+
+        static Batch Copy(const char *data, size_t len, bool binary, std::string_view logger_name)
+        {
+            Batch batch;
+            batch.buffer = std::make_shared<Buffer>(len + 1);
+            batch.buffer->Push(data, len);
+            batch.binary = binary;
+            batch.logger_name = logger_name;
+            return batch;
+        }
+
+        void Drop(size_t len)
+        {
+            stats_.dropped.fetch_add(1, std::memory_order_relaxed);
+            stats_.dropped_bytes.fetch_add(len, std::memory_order_relaxed);
+        }
+
+        void Enqueue(const Batch &batch)
+        {
+            size_t len = batch.buffer->ReadableSize();
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto fits = [this, len]()
+            { return bytes_ + len <= max_bytes_ || bytes_ == 0; };
+            if (!fits())
+            {
+                if (overflow_ == SinkOverflow::BLOCK)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    bool ok = cv_space_.wait_for(lock, timeout_, fits);
+                    stats_.blocked.fetch_add(1, std::memory_order_relaxed);
+                    stats_.blocked_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                    std::chrono::steady_clock::now() - start)
+                                                    .count(),
+                                                std::memory_order_relaxed);
+                    if (!ok)
+                    {
+                        Drop(len);
+                        return;
+                    }
+                }
+                else if (overflow_ == SinkOverflow::DROP_NEWEST)
+                {
+                    Drop(len);
+                    return;
+                }
+                else
+                {
+                    for (auto it = queue_.begin(); it != queue_.end() && !fits();)
+                    {
+                        if (it->marker != 0)
+                        {
+                            ++it; // 保留落盘标记
+                            continue;
+                        }
+                        size_t n = it->batch.buffer->ReadableSize();
+                        bytes_ -= n;
+                        Drop(n);
+                        it = queue_.erase(it);
+                    }
+                }
+            }
+            queue_.push_back(Item{batch, 0});
+            bytes_ += len;
+            stats_.batches.fetch_add(1, std::memory_order_relaxed);
+            cv_.notify_one();
+        }
+
+        // 写入线程：按顺序写出批次并处理落盘标记，组提交模式下定时醒来检查落盘
+        void ThreadEntry()
+        {
+            auto ready = [this]()
+            { return stop_ || !queue_.empty(); };
+            while (true)
+            {
+                Item item;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    if (tick_.count() != 0)
+                    {
+                        cv_.wait_for(lock, tick_, ready);
+                    }
+                    else
+                    {
+                        cv_.wait(lock, ready);
+                    }
+                    if (queue_.empty())
+                    {
+                        if (stop_)
+                        {
+                            break;
+                        }
+                        lock.unlock();
+                        flush_->Sync(false);
+                        continue;
+                    }
+                    item = std::move(queue_.front());
+                    queue_.pop_front();
+                    if (item.marker == 0)
+                    {
+                        bytes_ -= item.batch.buffer->ReadableSize();
+                    }
+                    busy_ = true;
+                }
+                cv_space_.notify_all();
+                if (item.marker != 0)
+                {
+                    flush_->Sync(true);
+                }
+                else if (item.batch.binary)
+                {
+                    flush_->FlushBinary(item.batch.logger_name, item.batch.buffer->Begin(), item.batch.buffer->ReadableSize());
+                }
+                else
+                {
+                    flush_->Flush(item.batch.buffer->Begin(), item.batch.buffer->ReadableSize());
+                }
+                item.batch.buffer.reset(); // 释放引用，最后一个引用释放时缓冲区回到池中
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    busy_ = false;
+                    synced_ = std::max(synced_, item.marker);
+                }
+                cv_idle_.notify_all();
+            }
+            flush_->Wait(); // 异步写入归属于本线程，退出前等待完成
+        }
+
+    private:
+        LogFlush::ptr flush_;                 // 被装饰的输出方式，只在写入线程中调用
+        size_t max_bytes_;                    // 队列中数据的最大字节数
+        SinkOverflow overflow_;               // 队列满时的处理方式
+        std::chrono::milliseconds timeout_;   // BLOCK方式和强制落盘的最长等待时间
+        std::chrono::milliseconds tick_{0};   // 写入线程定时醒来的间隔，0表示只在有数据时醒来
+        std::mutex mutex_;
+        std::condition_variable cv_;          // 通知写入线程
+        std::condition_variable cv_space_;    // 通知等待空间的生产者
+        std::condition_variable cv_idle_;     // 通知等待写完或落盘的线程
+        std::deque<Item> queue_;              // 待写入的批次和落盘标记
+        size_t bytes_ = 0;                    // 队列中数据的字节数
+        uint64_t markers_ = 0;                // 已插入的落盘标记数
+        uint64_t synced_ = 0;                 // 已完成的落盘标记
+        bool busy_ = false;                   // 写入线程是否正在写
+        bool stop_ = false;                   // 停止标志
+        QueueStats stats_;                    // 队列统计
+        std::thread thread_;                  // 写入线程，最后初始化
+    };
+}
@@ -0,0 +1,185 @@
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include "AsyncBuffer.hpp"
+
+namespace mylog
+{
+    // 无锁多生产者单消费者(MPSC)环形缓冲区
+    // 生产者通过 fetch_add 预留空间，写入数据后设置提交标志发布记录；
+    // 消费者按预留顺序读取已提交的记录，全程不加锁
+    class RingBuffer
+    {
+    public:
+        static constexpr size_t kHeaderSize = sizeof(uint64_t);   // 记录头大小(长度+提交标志)
+        static constexpr uint64_t kCommitted = 1ULL << 63;        // 提交标志位
+        static constexpr uint64_t kLenMask = kCommitted - 1;      // 长度掩码
+
+        // node>=0时数据区迁移到该NUMA节点
+        explicit RingBuffer(size_t capacity, int node = -1)
+            : capacity_(RoundUp(capacity)), mask_(capacity_ - 1),
+              data_(new uint64_t[capacity_ / sizeof(uint64_t)]()), write_(0), read_(0)
+        {
+            BindToNode(data_.get(), capacity_, node);
+        }
+
+        // 容量(字节)
+        size_t Capacity() const
+        {
+            return capacity_;
+        }
+
+        // 单条记录允许的最大长度，超过的记录由调用方截断
+        size_t MaxRecordSize() const
+        {
+            return capacity_ / 2 - kHeaderSize;
+        }
+
+        // 生产者写入一条记录，空间不足时让出CPU等待消费者释放空间
+        void Push(const char *data, size_t len)
+        {
+            assert(len <= MaxRecordSize());
+            uint64_t total = Align(kHeaderSize + len);
+            uint64_t pos = write_.fetch_add(total, std::memory_order_relaxed); // 预留空间
+            while (pos + total - read_.load(std::memory_order_acquire) > capacity_)
+            {
+                std::this_thread::yield();
+            }
+            CopyIn(pos + kHeaderSize, data, len);
+            // 发布记录，消费者看到提交标志后才会读取
+            Header(pos)->store(len | kCommitted, std::memory_order_seq_cst);
+        }
+
+        // 非阻塞写入，空间不足时返回false
+        bool TryPush(const char *data, size_t len)
+        {
+            assert(len <= MaxRecordSize());
+            uint64_t total = Align(kHeaderSize + len);
+            uint64_t pos = write_.load(std::memory_order_relaxed);
+            do
+            {
+                if (pos + total - read_.load(std::memory_order_acquire) > capacity_)
+                {
+                    return false;
+                }
+            } while (!write_.compare_exchange_weak(pos, pos + total, std::memory_order_relaxed));
+            CopyIn(pos + kHeaderSize, data, len);
+            Header(pos)->store(len | kCommitted, std::memory_order_seq_cst);
+            return true;
+        }
+
+        // 读指针处是否有已提交的记录
+        bool HasCommitted()
+        {
+            uint64_t r = read_.load(std::memory_order_relaxed);
+            return Header(r)->load(std::memory_order_seq_cst) & kCommitted;
+        }
+
+        // 是否还有已预留(含未提交)的数据
+        bool IsEmpty()
+        {
+            return write_.load(std::memory_order_acquire) == read_.load(std::memory_order_relaxed);
+        }
+
+        // 已预留的位置，单调递增
+        uint64_t WritePos()
+        {
+            return write_.load(std::memory_order_seq_cst);
+        }
+
+        // 已消费的位置，单调递增
+        uint64_t ReadPos()
+        {
+            return read_.load(std::memory_order_acquire);
+        }
+
+        // 消费者取出连续的已提交记录写入out，最多取出max_bytes字节，返回取出的字节数
+        size_t Drain(Buffer &out, size_t max_bytes)
+        {
+            size_t drained = 0;
+            uint64_t r = read_.load(std::memory_order_relaxed);
+            while (drained < max_bytes)
+            {
+                uint64_t h = Header(r)->load(std::memory_order_acquire);
+                if (!(h & kCommitted))
+                {
+                    break;
+                }
+                size_t len = h & kLenMask;
+                uint64_t total = Align(kHeaderSize + len);
+                CopyOut(out, r + kHeaderSize, len);
+                // 清零整段区域，避免旧数据在下一轮被误认为记录头
+                Zero(r, total);
+                r += total;
+                read_.store(r, std::memory_order_release); // 释放空间给生产者
+                drained += len;
+            }
+            return drained;
+        }
+
+    private:
+        static size_t RoundUp(size_t n)
+        {
+            size_t cap = 64 * 1024; // 最小容量
+            while (cap < n)
+            {
+                cap <<= 1;
+            }
+            return cap;
+        }
+
+        static uint64_t Align(uint64_t n)
+        {
+            return (n + kHeaderSize - 1) & ~(kHeaderSize - 1);
+        }
+
+        char *Bytes()
+        {
+            return reinterpret_cast<char *>(data_.get());
+        }
+
+        // 记录头总是8字节对齐，不会跨越缓冲区末尾
+        std::atomic<uint64_t> *Header(uint64_t pos)
+        {
+            return reinterpret_cast<std::atomic<uint64_t> *>(Bytes() + (pos & mask_));
+        }
+
+        void CopyIn(uint64_t pos, const char *src, size_t len)
+        {
+            size_t off = pos & mask_;
+            size_t first = std::min(len, capacity_ - off);
+            memcpy(Bytes() + off, src, first);
+            memcpy(Bytes(), src + first, len - first);
+        }
+
+        void CopyOut(Buffer &out, uint64_t pos, size_t len)
+        {
+            size_t off = pos & mask_;
+            size_t first = std::min(len, capacity_ - off);
+            out.Push(Bytes() + off, first);
+            out.Push(Bytes(), len - first);
+        }
+
+        void Zero(uint64_t pos, size_t len)
+        {
+            size_t off = pos & mask_;
+            size_t first = std::min(len, capacity_ - off);
+            memset(Bytes() + off, 0, first);
+            memset(Bytes(), 0, len - first);
+        }
+
+    private:
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "RingBuffer requires lock-free 64-bit atomics");
+
+        size_t capacity_;                     // 容量(2的幂)
+        size_t mask_;                         // 取模掩码
+        std::unique_ptr<uint64_t[]> data_;    // 数据区，按8字节对齐
+        alignas(64) std::atomic<uint64_t> write_; // 预留位置(单调递增)
+        alignas(64) std::atomic<uint64_t> read_;  // 消费位置(单调递增)
+    };
+}
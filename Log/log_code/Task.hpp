@@ -0,0 +1,353 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mylog
+{
+    // 小对象内存池：64/128/256/512字节四个大小类，每个线程缓存一批空闲块，
+    // 缓存过多时整批还给全局链表，缓存为空时整批取回；预热后提交任务不再调用malloc
+    class SmallBlockPool
+    {
+    public:
+        static constexpr size_t kMinBlock = 64;  // 最小块大小
+        static constexpr size_t kClasses = 4;    // 大小类个数，最大块为kMinBlock << (kClasses - 1)
+        static constexpr size_t kBatch = 64;     // 线程缓存与全局链表之间一次转移的块数
+
+        static SmallBlockPool &GetInstance()
+        {
+            static SmallBlockPool *pool = new SmallBlockPool; // 不析构，线程退出时仍可归还
+            return *pool;
+        }
+
+        // 禁用拷贝和赋值
+        SmallBlockPool(const SmallBlockPool &) = delete;
+        SmallBlockPool &operator=(const SmallBlockPool &) = delete;
+
+        void *Allocate(size_t size)
+        {
+            size_t cls = ClassOf(size);
+            if (cls >= kClasses)
+            {
+                return ::operator new(size);
+            }
+            FreeList &local = LocalCache().lists[cls];
+            if (local.head == nullptr)
+            {
+                Refill(cls, local);
+            }
+            Block *b = local.head;
+            local.head = b->next;
+            --local.count;
+            return b;
+        }
+
+        void Deallocate(void *p, size_t size)
+        {
+            size_t cls = ClassOf(size);
+            if (cls >= kClasses)
+            {
+                ::operator delete(p);
+                return;
+            }
+            FreeList &local = LocalCache().lists[cls];
+            Block *b = static_cast<Block *>(p);
+            b->next = local.head;
+            local.head = b;
+            if (++local.count > 2 * kBatch)
+            {
+                Spill(cls, local, kBatch);
+            }
+        }
+
+    private:
+        struct Block
+        {
+            Block *next;
+        };
+
+        struct FreeList
+        {
+            Block *head = nullptr;
+            size_t count = 0;
+        };
+
+        // 线程缓存，线程退出时还给全局链表
+        struct Cache
+        {
+            FreeList lists[kClasses];
+            ~Cache()
+            {
+                for (size_t cls = 0; cls < kClasses; ++cls)
+                {
+                    SmallBlockPool::GetInstance().Spill(cls, lists[cls], lists[cls].count);
+                }
+            }
+        };
+
+        SmallBlockPool() = default;
+
+        static size_t ClassOf(size_t size)
+        {
+            size_t cls = 0;
+            size_t block = kMinBlock;
+            while (block < size && cls < kClasses)
+            {
+                block <<= 1;
+                ++cls;
+            }
+            return cls;
+        }
+
+        static Cache &LocalCache()
+        {
+            static thread_local Cache cache;
+            return cache;
+        }
+
+        // 从全局链表取回一批，全局链表为空时向系统申请一批
+        void Refill(size_t cls, FreeList &local)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                FreeList &global = global_[cls];
+                while (global.head != nullptr && local.count < kBatch)
+                {
+                    Block *b = global.head;
+                    global.head = b->next;
+                    --global.count;
+                    b->next = local.head;
+                    local.head = b;
+                    ++local.count;
+                }
+            }
+            while (local.count < kBatch)
+            {
+                Block *b = static_cast<Block *>(::operator new(kMinBlock << cls));
+                b->next = local.head;
+                local.head = b;
+                ++local.count;
+            }
+        }
+
+        // 把n块还给全局链表
+        void Spill(size_t cls, FreeList &local, size_t n)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            FreeList &global = global_[cls];
+            while (n-- > 0 && local.head != nullptr)
+            {
+                Block *b = local.head;
+                local.head = b->next;
+                --local.count;
+                b->next = global.head;
+                global.head = b;
+                ++global.count;
+            }
+        }
+
+        std::mutex mutex_;
+        FreeList global_[kClasses]; // 全局空闲链表
+    };
+
+    // 从SmallBlockPool分配的标准分配器，用于std::promise等的共享状态
+    template <typename T>
+    struct PoolAllocator
+    {
+        using value_type = T;
+
+        PoolAllocator() = default;
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U> &) {}
+
+        T *allocate(size_t n)
+        {
+            return static_cast<T *>(SmallBlockPool::GetInstance().Allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T *p, size_t n)
+        {
+            SmallBlockPool::GetInstance().Deallocate(p, n * sizeof(T));
+        }
+
+        template <typename U>
+        bool operator==(const PoolAllocator<U> &) const { return true; }
+        template <typename U>
+        bool operator!=(const PoolAllocator<U> &) const { return false; }
+    };
+
+    // 只能移动的任务，不超过kInlineSize字节的可调用对象直接存放在任务内部，更大的从SmallBlockPool分配
+    class Task
+    {
+    public:
+        static constexpr size_t kInlineSize = 48;
+
+        Task() = default;
+
+        template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Task>::value>>
+        Task(F &&f)
+        {
+            using Fn = std::decay_t<F>;
+            if constexpr (sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+                          std::is_nothrow_move_constructible<Fn>::value)
+            {
+                new (storage_) Fn(std::forward<F>(f));
+                ops_ = &InlineOps<Fn>::ops;
+            }
+            else
+            {
+                void *p = SmallBlockPool::GetInstance().Allocate(sizeof(Fn));
+                try
+                {
+                    *reinterpret_cast<Fn **>(storage_) = new (p) Fn(std::forward<F>(f));
+                }
+                catch (...)
+                {
+                    SmallBlockPool::GetInstance().Deallocate(p, sizeof(Fn));
+                    throw;
+                }
+                ops_ = &HeapOps<Fn>::ops;
+            }
+        }
+
+        Task(Task &&other) noexcept
+        {
+            MoveFrom(other);
+        }
+
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                Reset();
+                MoveFrom(other);
+            }
+            return *this;
+        }
+
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            Reset();
+        }
+
+        explicit operator bool() const { return ops_ != nullptr; }
+
+        void operator()()
+        {
+            ops_->invoke(storage_);
+        }
+
+        // 销毁持有的可调用对象
+        void Reset()
+        {
+            if (ops_ != nullptr)
+            {
+                ops_->destroy(storage_);
+                ops_ = nullptr;
+            }
+        }
+
+    private:
+        struct Ops
+        {
+            void (*invoke)(void *);
+            void (*move)(void *src, void *dst); // 移动到dst并销毁src
+            void (*destroy)(void *);
+        };
+
+        template <typename Fn>
+        struct InlineOps
+        {
+            static void Invoke(void *s) { (*static_cast<Fn *>(s))(); }
+            static void Move(void *src, void *dst)
+            {
+                new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+                static_cast<Fn *>(src)->~Fn();
+            }
+            static void Destroy(void *s) { static_cast<Fn *>(s)->~Fn(); }
+            static constexpr Ops ops{&Invoke, &Move, &Destroy};
+        };
+
+        template <typename Fn>
+        struct HeapOps
+        {
+            static Fn *Get(void *s) { return *static_cast<Fn **>(s); }
+            static void Invoke(void *s) { (*Get(s))(); }
+            static void Move(void *src, void *dst) { *static_cast<Fn **>(dst) = Get(src); }
+            static void Destroy(void *s)
+            {
+                Fn *f = Get(s);
+                f->~Fn();
+                SmallBlockPool::GetInstance().Deallocate(f, sizeof(Fn));
+            }
+            static constexpr Ops ops{&Invoke, &Move, &Destroy};
+        };
+
+        void MoveFrom(Task &other)
+        {
+            ops_ = other.ops_;
+            if (ops_ != nullptr)
+            {
+                ops_->move(other.storage_, storage_);
+                other.ops_ = nullptr;
+            }
+        }
+
+        alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+        const Ops *ops_ = nullptr;
+    };
+
+    // 任务的环形队列，容量不足时翻倍，出队不释放内存，稳定状态下不再分配
+    class TaskQueue
+    {
+    public:
+        bool empty() const { return count_ == 0; }
+
+        size_t size() const { return count_; }
+
+        void push(Task &&task)
+        {
+            if (count_ == slots_.size())
+            {
+                Grow();
+            }
+            slots_[(head_ + count_) & (slots_.size() - 1)] = std::move(task);
+            ++count_;
+        }
+
+        Task &front()
+        {
+            return slots_[head_];
+        }
+
+        void pop()
+        {
+            slots_[head_].Reset();
+            head_ = (head_ + 1) & (slots_.size() - 1);
+            --count_;
+        }
+
+    private:
+        void Grow()
+        {
+            std::vector<Task> slots(slots_.empty() ? 64 : slots_.size() * 2);
+            for (size_t i = 0; i < count_; ++i)
+            {
+                slots[i] = std::move(slots_[(head_ + i) & (slots_.size() - 1)]);
+            }
+            slots_.swap(slots);
+            head_ = 0;
+        }
+
+        std::vector<Task> slots_; // 容量为2的幂
+        size_t head_ = 0;
+        size_t count_ = 0;
+    };
+}
@@ -6,46 +6,239 @@
 #include <mutex>
 #include <thread>
 #include <condition_variable>
-#include <queue>
 #include <cassert>
 #include <functional>
 #include <atomic>
 #include <future>
 #include <cstdarg>
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include "Affinity.hpp"
+#include "WorkStealingDeque.hpp"
+#include "Task.hpp"
+
+// 线程池选项
+struct ThreadPoolOptions
+{
+    size_t thread_count = std::thread::hardware_concurrency(); // 线程数量
+    std::vector<int> cpus;      // 非空时第i个线程绑定到cpus[i % cpus.size()]
+    bool work_stealing = false; // 工作窃取模式：每个线程一个Chase-Lev双端队列，外部提交的任务进入注入队列
+    // 空闲策略：没有任务时先自旋spin_count次，再让出CPU yield_count次，仍没有任务才休眠，默认直接休眠
+    size_t spin_count = 0;
+    size_t yield_count = 0;
+    // 动态线程数：min_threads < max_threads时，任务排队且没有空闲线程时增加线程(不超过max_threads)，
+    // 休眠超过keep_alive的线程退出(不少于min_threads)；为0时取thread_count
+    size_t min_threads = 0;
+    size_t max_threads = 0;
+    std::chrono::milliseconds keep_alive{1000};
+};
+
+// 一批任务的完成计数(类似latch)，等待整批任务完成而无需保存每个任务的future
+class TaskGroup
+{
+public:
+    // 增加n个未完成的任务
+    void add(size_t n = 1)
+    {
+        pending.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // 一个任务完成
+    void done()
+    {
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            condition.notify_all();
+        }
+    }
+
+    // 记录任务抛出的异常，只保留第一个
+    void fail(std::exception_ptr e)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error)
+        {
+            error = e;
+        }
+    }
+
+    // 是否所有任务都已完成
+    bool finished() const
+    {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+    // 等待所有任务完成，有任务抛出异常时重新抛出第一个
+    void wait()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]{ return finished(); });
+        }
+        rethrow();
+    }
+
+    // 重新抛出记录的异常
+    void rethrow()
+    {
+        std::exception_ptr e;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::swap(e, error);
+        }
+        if (e)
+        {
+            std::rethrow_exception(e);
+        }
+    }
+
+private:
+    std::atomic<size_t> pending{0};    // 未完成的任务数
+    std::mutex mutex;
+    std::condition_variable condition; // 全部完成时通知
+    std::exception_ptr error;          // 第一个异常
+};
 
 class ThreadPool
 {
 public:
 
-    // 获取线程池的单例实例，传入线程数量
-    static ThreadPool& GetInstance(int thread_count = std::thread::hardware_concurrency())
+    // 获取线程池的单例实例，传入线程数量；cpus非空时第i个线程绑定到cpus[i % cpus.size()]
+    // 绑定到某个NUMA节点可传入mylog::NumaTopology::GetInstance().CpusOfNode(node)
+    static ThreadPool& GetInstance(int thread_count = std::thread::hardware_concurrency(), const std::vector<int> &cpus = {})
+    {
+        ThreadPoolOptions options;
+        options.thread_count = thread_count;
+        options.cpus = cpus;
+        return GetInstance(options);
+    }
+
+    // 按选项获取线程池的单例实例，只有第一次调用的选项生效
+    static ThreadPool& GetInstance(const ThreadPoolOptions &options)
     {
-        static ThreadPool instance(thread_count); // 使用静态变量保证单例
+        static ThreadPool instance(options); // 使用静态变量保证单例
         return instance;
     }
 
+    // 日志系统内部的后台任务(压缩、清理旧文件)使用的线程池，与GetInstance的实例相互独立，只有第一次调用的线程数生效
+    // 不析构：日志器在静态对象析构阶段最后一次滚动文件时仍会提交任务，而GetInstance的实例创建得晚、析构得早
+    // 进程退出时未完成的任务随之终止，压缩到一半的文件只留下.tmp，原文件保持不变
+    static ThreadPool& Background(int thread_count)
+    {
+        ThreadPoolOptions options;
+        options.thread_count = thread_count;
+        static ThreadPool *instance = new ThreadPool(options);
+        return *instance;
+    }
+
     // 添加任务到线程池队列中
     template <typename F, typename... Args>
     auto enqueue(F &&f, Args &&...args) -> std::future<std::invoke_result_t<F, Args...>>
     {
         using return_type = std::invoke_result_t<F, Args...>; // 推导任务返回值类型
 
-        // 将任务封装为 std::packaged_task
-        auto task = std::make_shared<std::packaged_task<return_type>>([func = std::forward<F>(f), args...]() mutable
-                                                                      { return std::invoke(func, args...); });
+        // 共享状态从内存池分配，promise随任务移动，小任务直接存放在Task内部，稳定状态下不分配堆内存
+        std::promise<return_type> promise(std::allocator_arg, mylog::PoolAllocator<char>());
+        std::future<return_type> res = promise.get_future(); // 获取任务的 future 对象
+        submit(Task([promise = std::move(promise), func = std::forward<F>(f), args...]() mutable
+                    {
+                        try
+                        {
+                            if constexpr (std::is_void<return_type>::value)
+                            {
+                                std::invoke(func, args...);
+                                promise.set_value();
+                            }
+                            else
+                            {
+                                promise.set_value(std::invoke(func, args...));
+                            }
+                        }
+                        catch (...)
+                        {
+                            promise.set_exception(std::current_exception());
+                        }
+                    }));
+        return res;             // 返回任务的 future 对象
+    }
+
+    // 添加不需要返回值的任务，不创建future；任务抛出的异常被捕获并打印
+    template <typename F, typename... Args>
+    void post(F &&f, Args &&...args)
+    {
+        submit(Task([func = std::forward<F>(f), args...]() mutable
+                    {
+                        try
+                        {
+                            std::invoke(func, args...);
+                        }
+                        catch (const std::exception &e)
+                        {
+                            std::cout << __FILE__ << __LINE__ << "posted task threw: " << e.what() << std::endl;
+                        }
+                        catch (...)
+                        {
+                            std::cout << __FILE__ << __LINE__ << "posted task threw" << std::endl;
+                        }
+                    }));
+    }
+
+    // 批量提交[first, last)中的可调用对象(无返回值、无future)，只加一次锁，按任务数唤醒相应数量的线程
+    template <typename It>
+    void enqueue_bulk(It first, It last)
+    {
+        submit_bulk(nullptr, first, last);
+    }
+
+    // 批量提交并用group跟踪完成情况，任务抛出的异常记录在group中，由group.wait()重新抛出
+    template <typename It>
+    void enqueue_bulk(TaskGroup &group, It first, It last)
+    {
+        submit_bulk(&group, first, last);
+    }
 
-        std::future<return_type> res = task->get_future(); // 获取任务的 future 对象
+    // 等待group中的任务完成；在本线程池的线程中调用时一边等待一边执行队列中的任务，避免所有线程都在等待而死锁
+    void wait(TaskGroup &group)
+    {
+        if (current_pool == this)
         {
-            std::unique_lock<std::mutex> lock(queue_mutex); // 加锁保护任务队列
-            if (stop)
+            while (!group.finished())
             {
-                throw std::runtime_error("enqueue on stopped ThreadPool"); // 如果线程池已停止，抛出异常
+                if (!run_one())
+                {
+                    std::this_thread::yield();
+                }
             }
-            // 将任务加入队列
-            m_queue.emplace([task](){ (*task)(); });
+            group.rethrow();
+            return;
         }
-        condition.notify_one(); // 通知一个等待的线程
-        return res;             // 返回任务的 future 对象
+        group.wait();
+    }
+
+    // 在当前线程执行一个排队的任务，没有任务时返回false；等待线程池中的结果时可以借此帮忙执行任务
+    bool run_one()
+    {
+        Task task;
+        if (work_stealing)
+        {
+            // 外部线程没有自己的双端队列，只从注入队列取或窃取
+            if (!find_task(current_pool == this ? current_index : kNoIndex, task))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            if (!pop_injected(task))
+            {
+                return false;
+            }
+        }
+        task();
+        return true;
     }
 
     ~ThreadPool()
@@ -53,38 +246,393 @@ public:
         shutdown(); // 析构时关闭线程池
     }
 
-    // 获取线程池中线程的数量
+    // 获取线程池中当前线程的数量
     size_t size() const
     {
-        return workers.size();
+        return live_threads.load(std::memory_order_relaxed);
     }
 
 private:
+    using Task = mylog::Task;
+
     // 构造函数，初始化线程池并启动指定数量的线程
-    explicit ThreadPool(int thread_count) : stop(false)
+    explicit ThreadPool(const ThreadPoolOptions &options)
+        : stop(false), work_stealing(options.work_stealing), cpus(options.cpus), spin_count(options.spin_count),
+          yield_count(options.yield_count), keep_alive(options.keep_alive)
     {
-        workers.reserve(thread_count); // 预留线程数量
-        for (int i = 0; i < thread_count; ++i)
+        size_t thread_count = std::max<size_t>(1, options.thread_count);
+        min_threads = options.min_threads != 0 ? options.min_threads : thread_count;
+        max_threads = std::max(options.max_threads != 0 ? options.max_threads : thread_count, min_threads);
+        thread_count = std::min(std::max(thread_count, min_threads), max_threads);
+        // 按最大线程数预留槽位，退出的线程留下的槽位(及其双端队列)由新线程复用
+        workers.resize(max_threads);
+        active.resize(max_threads, false);
+        if (work_stealing)
         {
-            workers.emplace_back([this]{
-            while(true){
-                std::function<void()> task;
-                {
-                    std::unique_lock<std::mutex> lock(this->queue_mutex); // 加锁保护任务队列
-                    // 等待条件变量，直到有任务或线程池停止
-                    this->condition.wait(lock,[this]{return this->stop || !this->m_queue.empty();});
-                    if(this->stop && this->m_queue.empty()){
-                        return; // 如果线程池停止且任务队列为空，退出线程
-                    }
-                    task = std::move(this->m_queue.front()); // 取出队列中的任务
-                    this->m_queue.pop(); // 移除任务
-                }
+            for (size_t i = 0; i < max_threads; ++i)
+            {
+                local_queues.emplace_back(new mylog::WorkStealingDeque<Task *>());
+            }
+        }
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        for (size_t i = 0; i < thread_count; ++i)
+        {
+            spawn();
+        }
+    }
+
+    // 在空闲槽位上启动一个线程，调用方需持有queue_mutex
+    void spawn()
+    {
+        size_t i = std::find(active.begin(), active.end(), false) - active.begin();
+        if (i == active.size())
+        {
+            return;
+        }
+        if (workers[i].joinable())
+        {
+            workers[i].join(); // 此前退出的线程，已不再访问线程池
+        }
+        active[i] = true;
+        live_threads.fetch_add(1, std::memory_order_relaxed);
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        workers[i] = std::thread([this, cpu, i]{
+            if(cpu >= 0){
+                mylog::PinThread(pthread_self(), {cpu}); // 绑定到指定CPU
+            }
+            current_pool = this;
+            current_index = i;
+            this->worker_loop(i);
+        });
+    }
+
+    // 排队的任务数超过空闲线程数时增加一个线程，调用方需持有queue_mutex
+    void maybe_grow(size_t queued)
+    {
+        if (max_threads > min_threads && queued > idle.load(std::memory_order_seq_cst) &&
+            live_threads.load(std::memory_order_relaxed) < max_threads && !stop)
+        {
+            spawn();
+        }
+    }
+
+    // 提交任务：工作窃取模式下本线程池的线程提交到自己的双端队列(无锁)，其余进入共享队列
+    void submit(Task &&task)
+    {
+        if (work_stealing && current_pool == this)
+        {
+            // 线程池关闭过程中仍在运行的任务可以继续派生子任务，由本线程在退出前执行完
+            local_queues[current_index]->Push(new_node(std::move(task)));
+            if (sleepers.load(std::memory_order_seq_cst) > 0)
+            {
+                { std::lock_guard<std::mutex> lock(queue_mutex); } // 与休眠线程检查条件的过程互斥，避免丢失唤醒
+                condition.notify_one();
+            }
+            else if (max_threads > min_threads && idle.load(std::memory_order_seq_cst) == 0)
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                maybe_grow(local_queues[current_index]->Size());
+            }
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex); // 加锁保护任务队列
+            if (stop)
+            {
+                throw std::runtime_error("enqueue on stopped ThreadPool"); // 如果线程池已停止，抛出异常
+            }
+            // 将任务加入队列
+            m_queue.push(std::move(task));
+            injected.store(m_queue.size(), std::memory_order_relaxed);
+            maybe_grow(m_queue.size());
+        }
+        condition.notify_one(); // 通知一个等待的线程
+    }
+
+    template <typename It>
+    void submit_bulk(TaskGroup *group, It first, It last)
+    {
+        size_t n = static_cast<size_t>(std::distance(first, last));
+        if (n == 0)
+        {
+            return;
+        }
+        // 每个任务拷贝一份可调用对象，完成时通知group
+        auto make = [group](const auto &f)
+        {
+            return Task([f, group]() mutable
+                        {
+                            try
+                            {
+                                f();
+                            }
+                            catch (...)
+                            {
+                                if (group == nullptr)
+                                {
+                                    std::cout << __FILE__ << __LINE__ << "bulk task threw" << std::endl;
+                                }
+                                else
+                                {
+                                    group->fail(std::current_exception());
+                                }
+                            }
+                            if (group != nullptr)
+                            {
+                                group->done();
+                            }
+                        });
+        };
+        if (work_stealing && current_pool == this)
+        {
+            if (group != nullptr)
+            {
+                group->add(n);
+            }
+            for (It it = first; it != last; ++it)
+            {
+                local_queues[current_index]->Push(new_node(make(*it)));
+            }
+            size_t parked = sleepers.load(std::memory_order_seq_cst);
+            if (parked > 0)
+            {
+                { std::lock_guard<std::mutex> lock(queue_mutex); }
+                wake(std::min(n - 1, parked)); // 本线程自己也会执行
+            }
+            else if (max_threads > min_threads && idle.load(std::memory_order_seq_cst) == 0)
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                maybe_grow(local_queues[current_index]->Size());
+            }
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex); // 整批只加一次锁
+            if (stop)
+            {
+                throw std::runtime_error("enqueue on stopped ThreadPool");
+            }
+            if (group != nullptr)
+            {
+                group->add(n);
+            }
+            for (It it = first; it != last; ++it)
+            {
+                m_queue.push(make(*it));
+            }
+            injected.store(m_queue.size(), std::memory_order_relaxed);
+            maybe_grow(m_queue.size());
+        }
+        wake(n);
+    }
+
+    // 唤醒n个等待的线程，不少于线程数时全部唤醒
+    void wake(size_t n)
+    {
+        if (n >= size())
+        {
+            condition.notify_all();
+            return;
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            condition.notify_one();
+        }
+    }
+
+    // 线程主循环：工作窃取模式下先取自己的队列，再取共享队列，最后从随机的其他线程窃取；没有任务时按空闲策略等待
+    void worker_loop(size_t index)
+    {
+        Task task;
+        while (true)
+        {
+            if (take_task(index, task))
+            {
                 task(); // 执行任务
+                task.Reset();
+                continue;
+            }
+            if (!idle_wait())
+            {
+                return; // 线程池停止或空闲过久，退出线程
             }
-         });
         }
     }
 
+    bool take_task(size_t index, Task &task)
+    {
+        if (work_stealing)
+        {
+            return find_task(index, task);
+        }
+        if (injected.load(std::memory_order_relaxed) == 0)
+        {
+            return false;
+        }
+        std::unique_lock<std::mutex> lock(queue_mutex); // 加锁保护任务队列
+        return pop_injected(task);
+    }
+
+    // 从共享队列取出一个任务，调用方需持有queue_mutex
+    bool pop_injected(Task &task)
+    {
+        if (m_queue.empty())
+        {
+            return false;
+        }
+        task = std::move(m_queue.front()); // 取出队列中的任务
+        m_queue.pop();                     // 移除任务
+        injected.store(m_queue.size(), std::memory_order_relaxed);
+        return true;
+    }
+
+    // 不加锁地判断是否可能有任务，用于自旋阶段
+    bool work_hint() const
+    {
+        if (injected.load(std::memory_order_relaxed) > 0)
+        {
+            return true;
+        }
+        for (auto &q : local_queues)
+        {
+            if (q->Size() > 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 没有任务时先自旋、再让出CPU、最后休眠，返回false表示线程应退出
+    bool idle_wait()
+    {
+        idle.fetch_add(1, std::memory_order_seq_cst);
+        for (size_t i = 0; i < spin_count + yield_count; ++i)
+        {
+            if (stop)
+            {
+                break; // 直接去检查是否退出
+            }
+            if (work_hint())
+            {
+                idle.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            if (i < spin_count)
+            {
+                cpu_relax();
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        // 先登记为休眠线程再检查条件，与submit中的检查构成Dekker同步
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        auto ready = [this]{ return stop || has_work(); };
+        bool timed_out = false;
+        if (max_threads > min_threads)
+        {
+            timed_out = !condition.wait_for(lock, keep_alive, ready);
+        }
+        else
+        {
+            condition.wait(lock, ready); // 等待条件变量，直到有任务或线程池停止
+        }
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        idle.fetch_sub(1, std::memory_order_relaxed);
+        if ((stop || (timed_out && live_threads.load(std::memory_order_relaxed) > min_threads)) && !has_work())
+        {
+            active[current_index] = false; // 槽位可由新线程复用，线程对象在复用或关闭时回收
+            live_threads.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    static void cpu_relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    static constexpr size_t kNoIndex = static_cast<size_t>(-1); // 外部线程
+
+    bool find_task(size_t index, Task &task)
+    {
+        Task *p = nullptr;
+        if (index != kNoIndex && local_queues[index]->Pop(p))
+        {
+            task = take_node(p);
+            return true;
+        }
+        if (injected.load(std::memory_order_relaxed) > 0)
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            if (pop_injected(task))
+            {
+                return true;
+            }
+        }
+        size_t n = local_queues.size();
+        size_t start = next_victim() % n;
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t victim = (start + i) % n;
+            if (victim != index && local_queues[victim]->Steal(p))
+            {
+                task = take_node(p);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 双端队列只能存放指针，任务节点从内存池分配
+    static Task *new_node(Task &&task)
+    {
+        return new (mylog::SmallBlockPool::GetInstance().Allocate(sizeof(Task))) Task(std::move(task));
+    }
+
+    static Task take_node(Task *node)
+    {
+        Task task(std::move(*node));
+        node->~Task();
+        mylog::SmallBlockPool::GetInstance().Deallocate(node, sizeof(Task));
+        return task;
+    }
+
+    // 是否还有任务，调用方需持有queue_mutex
+    bool has_work() const
+    {
+        if (!m_queue.empty())
+        {
+            return true;
+        }
+        for (auto &q : local_queues)
+        {
+            if (!q->Empty())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 随机选择窃取对象，避免所有线程同时窃取同一个队列
+    static size_t next_victim()
+    {
+        static thread_local uint64_t x = 0x9E3779B97F4A7C15ULL ^ reinterpret_cast<uintptr_t>(&x);
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return static_cast<size_t>(x);
+    }
+
     // 关闭线程池，等待所有线程完成
     void shutdown()
     {
@@ -112,8 +660,23 @@ private:
 
 private:
     std::vector<std::thread> workers;          // 工作线程集合
-    std::queue<std::function<void()>> m_queue; // 任务队列
+    mylog::TaskQueue m_queue;                  // 任务队列(工作窃取模式下为注入队列)
     std::mutex queue_mutex;                    // 保护任务队列的互斥锁
     std::condition_variable condition;         // 条件变量，用于线程间同步
     std::atomic<bool> stop;                    // 标志线程池是否停止
+    bool work_stealing;                        // 是否为工作窃取模式
+    std::vector<std::unique_ptr<mylog::WorkStealingDeque<Task *>>> local_queues; // 每个线程的双端队列(工作窃取模式)
+    std::atomic<size_t> injected{0};           // 共享队列中的任务数，避免工作窃取模式下空队列时加锁
+    std::atomic<size_t> sleepers{0};           // 正在休眠的线程数
+    std::atomic<size_t> idle{0};               // 正在自旋或休眠的线程数
+    std::atomic<size_t> live_threads{0};       // 当前的线程数
+    std::vector<bool> active;                  // 槽位上是否有运行中的线程，由queue_mutex保护
+    std::vector<int> cpus;                     // 非空时第i个槽位的线程绑定到cpus[i % cpus.size()]
+    size_t spin_count;                         // 休眠前的自旋次数
+    size_t yield_count;                        // 自旋后让出CPU的次数
+    size_t min_threads;                        // 最少线程数
+    size_t max_threads;                        // 最多线程数
+    std::chrono::milliseconds keep_alive;      // 多余线程休眠多久后退出
+    static inline thread_local ThreadPool *current_pool = nullptr; // 当前线程所属的线程池
+    static inline thread_local size_t current_index = 0;           // 当前线程在线程池中的序号
 };
\ No newline at end of file
@@ -0,0 +1,318 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mylog
+{
+    // 文本日志文件的时间索引(与日志文件同名加".idx"的旁路文件)
+    // 文件以8字节魔数"MYLOGIDX"、u32版本号、u32桶宽(秒)开头，之后是定长条目，每个时间桶一个:
+    //   i64 桶起始时间(秒) | u64 桶内第一行在日志文件中的偏移 | u32 行数 | u32 出现过的级别(按LogLevel::value的位掩码)
+    // 偏移单调递增；多线程写入的行时间可能略有乱序，迟到的行计入当前桶，查询时需向前后多看kSlack秒
+    namespace timeindex
+    {
+        constexpr char kMagic[8] = {'M', 'Y', 'L', 'O', 'G', 'I', 'D', 'X'};
+        constexpr uint32_t kVersion = 1;
+        constexpr int64_t kSlack = 5; // 行时间相对所在桶的最大乱序(秒)，覆盖暂存和批量提交的延迟
+
+        struct Header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t bucket;
+        };
+
+        struct Entry
+        {
+            int64_t start;
+            uint64_t offset;
+            uint32_t count;
+            uint32_t levels;
+        };
+
+        static_assert(sizeof(Header) == 16 && sizeof(Entry) == 24, "index layout must be packed");
+
+        // 解析行首"[HH:MM:SS.uuuuuu][tid][LEVEL]"，得到当天的秒数和级别，不是日志行的开头(如多行消息的后续行)时返回false
+        inline bool ParseLine(const char *p, size_t n, int &sec_of_day, int &level)
+        {
+            if (n < 20 || p[0] != '[' || p[3] != ':' || p[6] != ':' || p[16] != ']' || p[17] != '[')
+            {
+                return false;
+            }
+            int v[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                char a = p[1 + i * 3], b = p[2 + i * 3];
+                if (a < '0' || a > '9' || b < '0' || b > '9')
+                {
+                    return false;
+                }
+                v[i] = (a - '0') * 10 + (b - '0');
+            }
+            sec_of_day = v[0] * 3600 + v[1] * 60 + v[2];
+            const char *q = static_cast<const char *>(memchr(p + 18, ']', n - 18));
+            if (q == nullptr || q + 3 >= p + n || q[1] != '[')
+            {
+                return false;
+            }
+            switch (q[2])
+            {
+            case 'D':
+                level = 0;
+                break;
+            case 'I':
+                level = 1;
+                break;
+            case 'W':
+                level = 2;
+                break;
+            case 'E':
+                level = 3;
+                break;
+            case 'F':
+                level = 4;
+                break;
+            default:
+                return false;
+            }
+            return true;
+        }
+
+        // 当地时间的当天秒数
+        inline int SecondOfDay(time_t t)
+        {
+            struct tm tm;
+            localtime_r(&t, &tm);
+            return tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+        }
+
+        // 以ref为参照把当天的秒数还原为时间戳，取离ref最近的一天
+        inline int64_t ToTime(int64_t ref, int ref_sec_of_day, int sec_of_day)
+        {
+            int64_t diff = sec_of_day - ref_sec_of_day;
+            if (diff > 43200)
+            {
+                diff -= 86400;
+            }
+            else if (diff < -43200)
+            {
+                diff += 86400;
+            }
+            return ref + diff;
+        }
+
+        // 写入端，只在日志文件的写入线程中使用；每批数据扫描一次行首，每批最多一次pwrite
+        class Writer
+        {
+        public:
+            ~Writer()
+            {
+                Close();
+            }
+
+            // 打开索引文件；已有的索引(同名日志文件接着写)保留并在其后追加
+            bool Open(const std::string &path, uint32_t bucket)
+            {
+                Close();
+                bucket_ = bucket ? bucket : 1;
+                fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+                if (fd_ < 0)
+                {
+                    std::cout << __FILE__ << __LINE__ << "open index " << path << " failed" << std::endl;
+                    perror(NULL);
+                    return false;
+                }
+                struct stat st;
+                Header header;
+                if (fstat(fd_, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(header) &&
+                    pread(fd_, &header, sizeof(header), 0) == sizeof(header) && memcmp(header.magic, kMagic, 8) == 0)
+                {
+                    bucket_ = header.bucket;
+                    pos_ = sizeof(header) + (st.st_size - sizeof(header)) / sizeof(Entry) * sizeof(Entry);
+                    return true;
+                }
+                memcpy(header.magic, kMagic, 8);
+                header.version = kVersion;
+                header.bucket = bucket_;
+                if (ftruncate(fd_, 0) != 0 || pwrite(fd_, &header, sizeof(header), 0) != sizeof(header))
+                {
+                    std::cout << __FILE__ << __LINE__ << "write index " << path << " failed" << std::endl;
+                    perror(NULL);
+                    Close();
+                    return false;
+                }
+                pos_ = sizeof(header);
+                return true;
+            }
+
+            // 写入索引文件中的当前桶并关闭
+            void Close()
+            {
+                if (fd_ < 0)
+                {
+                    return;
+                }
+                Commit();
+                close(fd_);
+                fd_ = -1;
+                open_ = false;
+            }
+
+            // 记录即将写入日志文件offset处的[data, data+len)
+            void Add(const char *data, size_t len, uint64_t offset)
+            {
+                if (fd_ < 0)
+                {
+                    return;
+                }
+                time_t now = time(nullptr);
+                if (now < hour_start_ || now >= hour_start_ + 3600)
+                {
+                    // 每小时调用一次localtime_r，之后按相对整点的秒数换算
+                    int sec = SecondOfDay(now);
+                    hour_start_ = now - sec % 3600;
+                    hour_sec_ = sec - sec % 3600;
+                }
+                const char *p = data;
+                const char *end = data + len;
+                while (p < end)
+                {
+                    const char *nl = static_cast<const char *>(memchr(p, '\n', end - p));
+                    size_t n = nl ? nl - p + 1 : end - p;
+                    int sec, level;
+                    if (ParseLine(p, n, sec, level))
+                    {
+                        int64_t t = ToTime(hour_start_, hour_sec_, sec);
+                        if (!open_ || t >= cur_.start + bucket_)
+                        {
+                            Commit();
+                            if (open_)
+                            {
+                                pos_ += sizeof(Entry);
+                            }
+                            cur_.start = t - t % bucket_;
+                            cur_.offset = offset + (p - data);
+                            cur_.count = 0;
+                            cur_.levels = 0;
+                            open_ = true;
+                        }
+                        ++cur_.count;
+                        cur_.levels |= 1u << level;
+                        dirty_ = true;
+                    }
+                    p += n;
+                }
+                Commit();
+            }
+
+        private:
+            // 把当前桶写入(覆盖)其在索引文件中的位置
+            void Commit()
+            {
+                if (!open_ || !dirty_)
+                {
+                    return;
+                }
+                if (pwrite(fd_, &cur_, sizeof(cur_), pos_) != sizeof(cur_))
+                {
+                    std::cout << __FILE__ << __LINE__ << "write index failed" << std::endl;
+                    perror(NULL);
+                }
+                dirty_ = false;
+            }
+
+            int fd_ = -1;
+            uint32_t bucket_ = 1;
+            uint64_t pos_ = 0;       // 当前桶在索引文件中的位置
+            Entry cur_;              // 当前桶
+            bool open_ = false;      // 是否有当前桶
+            bool dirty_ = false;     // 当前桶是否有未写入的修改
+            time_t hour_start_ = 0;  // 缓存的当前整点时间
+            int hour_sec_ = 0;       // 当前整点的当天秒数
+        };
+
+        // 读取端，通过mmap访问索引
+        class Reader
+        {
+        public:
+            ~Reader()
+            {
+                if (map_ != nullptr)
+                {
+                    munmap(map_, size_);
+                }
+            }
+
+            bool Open(const std::string &path)
+            {
+                int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0)
+                {
+                    return false;
+                }
+                struct stat st;
+                if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header))
+                {
+                    close(fd);
+                    return false;
+                }
+                size_ = st.st_size;
+                void *p = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+                close(fd);
+                if (p == MAP_FAILED)
+                {
+                    return false;
+                }
+                map_ = p;
+                const Header *header = static_cast<const Header *>(map_);
+                if (memcmp(header->magic, kMagic, 8) != 0 || header->version != kVersion)
+                {
+                    return false;
+                }
+                bucket_ = header->bucket;
+                entries_ = reinterpret_cast<const Entry *>(static_cast<const char *>(map_) + sizeof(Header));
+                count_ = (size_ - sizeof(Header)) / sizeof(Entry);
+                return true;
+            }
+
+            uint32_t Bucket() const { return bucket_; }
+
+            size_t Count() const { return count_; }
+
+            const Entry &At(size_t i) const { return entries_[i]; }
+
+            // 第一个可能包含from之后的行的桶(二分查找)
+            size_t LowerBound(int64_t from) const
+            {
+                size_t lo = 0, hi = count_;
+                while (lo < hi)
+                {
+                    size_t mid = (lo + hi) / 2;
+                    if (entries_[mid].start + bucket_ + kSlack <= from)
+                    {
+                        lo = mid + 1;
+                    }
+                    else
+                    {
+                        hi = mid;
+                    }
+                }
+                return lo;
+            }
+
+        private:
+            void *map_ = nullptr;
+            size_t size_ = 0;
+            uint32_t bucket_ = 1;
+            const Entry *entries_ = nullptr;
+            size_t count_ = 0;
+        };
+    }
+}
@@ -0,0 +1,427 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+#include "AsyncBuffer.hpp"
+#include "LogFlush.hpp"
+
+namespace mylog
+{
+    // 通过io_uring异步写文件的实现类，最多depth个缓冲区同时在途，消费者线程不再阻塞在write/fsync上
+    // 每个缓冲区按自己记录的文件偏移写入，完成顺序不影响文件内容的顺序
+    // 按落盘策略(见GroupCommit)在写入后提交fdatasync(排在此前所有写入之后)，内核不支持io_uring时退回pwritev同步写入
+    class UringFileFlush : public LogFlush
+    {
+    public:
+        using ptr = std::shared_ptr<UringFileFlush>;
+        UringFileFlush(const std::string &filename, size_t depth = 4) : filename_(filename), slots_(depth ? depth : 1)
+        {
+            Util::File::CreateDirectory(Util::File::Path(filename));
+            fd_ = open(filename.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+            if (fd_ < 0)
+            {
+                std::cout << __FILE__ << __LINE__ << "open file " << filename << " failed" << std::endl;
+                perror(NULL);
+                return;
+            }
+            struct stat st;
+            if (fstat(fd_, &st) == 0)
+            {
+                offset_ = st.st_size; // 追加写
+            }
+            if (!SetupRing(slots_.size() * 2))
+            {
+                std::cout << __FILE__ << __LINE__ << "io_uring unavailable, fall back to pwritev" << std::endl;
+            }
+        }
+
+        ~UringFileFlush()
+        {
+            Sync(g_conf_data->flush_log >= 2);
+            if (ring_fd_ >= 0)
+            {
+                Wait();
+                munmap(sqes_, sqes_size_);
+                munmap(sq_ptr_, sq_size_);
+                if (cq_ptr_ != sq_ptr_)
+                {
+                    munmap(cq_ptr_, cq_size_);
+                }
+                close(ring_fd_);
+            }
+            if (fd_ >= 0)
+            {
+                close(fd_);
+            }
+        }
+
+        // 拷贝到空闲缓冲区后提交
+        void Flush(const char *data, size_t len) override
+        {
+            if (fd_ < 0 || len == 0)
+            {
+                return;
+            }
+            if (ring_fd_ < 0)
+            {
+                WriteSync(data, len);
+                return;
+            }
+            Slot &slot = AcquireSlot();
+            slot.buffer.Push(data, len);
+            Submit(slot);
+        }
+
+        // 直接接管缓冲区：与一个已完成的空闲缓冲区交换，写入完成后该缓冲区再交还给工作器复用
+        bool TakeBuffer(Buffer &buffer) override
+        {
+            if (fd_ < 0 || ring_fd_ < 0 || buffer.IsEmpty())
+            {
+                return false;
+            }
+            Slot &slot = AcquireSlot();
+            slot.buffer.Swap(buffer);
+            Submit(slot);
+            return true;
+        }
+
+        // 强制落盘时等待fdatasync完成才返回
+        void Sync(bool force) override
+        {
+            if (fd_ < 0 || !commit_.Due(force))
+            {
+                return;
+            }
+            if (ring_fd_ < 0)
+            {
+                commit_.Sync(force, [this]()
+                             { fdatasync(fd_); });
+                return;
+            }
+            while (inflight_ + 1 > entries_)
+            {
+                Reap(true);
+            }
+            PrepareSync(force);
+            SubmitPending();
+            if (force)
+            {
+                Wait();
+            }
+            else
+            {
+                Reap(false);
+            }
+        }
+
+        const SyncStats *GetSyncStats() const override { return &commit_.Stats(); }
+
+        // 写入失败而丢失的字节数
+        uint64_t LostBytes() const { return lost_bytes_.load(std::memory_order_relaxed); }
+
+        // 请求归属于提交它的线程，线程退出时内核会取消未完成的请求，因此消费者线程退出前必须等待
+        void Wait() override
+        {
+            while (ring_fd_ >= 0 && inflight_ > 0)
+            {
+                Reap(true);
+            }
+        }
+
+    private:
+        static constexpr uint64_t kSyncTag = ~0ULL; // fdatasync请求的user_data
+
+        // 一个在途缓冲区，容量与工作器的缓冲区相同，交换给工作器后不会使其变小
+        struct Slot
+        {
+            Buffer buffer;     // 待写数据
+            off_t offset = 0;  // 写入的文件偏移
+            size_t done = 0;   // 已写入的字节数
+            bool busy = false; // 是否在途
+            struct iovec iov;  // 本次提交的区间，需在完成前保持有效
+        };
+
+        static int Setup(unsigned entries, struct io_uring_params *p)
+        {
+            return syscall(__NR_io_uring_setup, entries, p);
+        }
+
+        static int Enter(int fd, unsigned submit, unsigned wait, unsigned flags)
+        {
+            return syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+        }
+
+        // 建立提交队列和完成队列的共享内存映射
+        bool SetupRing(unsigned entries)
+        {
+            struct io_uring_params p;
+            memset(&p, 0, sizeof(p));
+            int fd = Setup(entries, &p);
+            if (fd < 0)
+            {
+                return false;
+            }
+            sq_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+            cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+            bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+            if (single)
+            {
+                sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+            }
+            sq_ptr_ = mmap(NULL, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if (sq_ptr_ == MAP_FAILED)
+            {
+                close(fd);
+                return false;
+            }
+            cq_ptr_ = single ? sq_ptr_ : mmap(NULL, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+            sqes_ = cq_ptr_ == MAP_FAILED ? MAP_FAILED : mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if (sqes_ == MAP_FAILED)
+            {
+                if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_)
+                {
+                    munmap(cq_ptr_, cq_size_);
+                }
+                munmap(sq_ptr_, sq_size_);
+                close(fd);
+                return false;
+            }
+            char *sq = static_cast<char *>(sq_ptr_);
+            char *cq = static_cast<char *>(cq_ptr_);
+            sq_tail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+            sq_mask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+            sq_array_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+            cq_head_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+            cq_tail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+            cq_mask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + p.cq_off.cqes);
+            entries_ = p.sq_entries;
+            ring_fd_ = fd;
+            return true;
+        }
+
+        // 取一个空闲缓冲区，全部在途时等待最早的完成
+        Slot &AcquireSlot()
+        {
+            while (true)
+            {
+                // 每次提交最多产生两个完成事件(写入+fdatasync)，完成队列不会溢出
+                for (auto &slot : slots_)
+                {
+                    if (!slot.busy && inflight_ + 2 <= entries_)
+                    {
+                        slot.buffer.Reset();
+                        return slot;
+                    }
+                }
+                Reap(true);
+            }
+        }
+
+        // 分配文件偏移并提交写入，需要落盘时追加一个排在其后的fdatasync
+        void Submit(Slot &slot)
+        {
+            slot.busy = true;
+            slot.offset = offset_;
+            slot.done = 0;
+            offset_ += slot.buffer.ReadableSize();
+            PrepareWrite(slot);
+            commit_.Written(slot.buffer.ReadableSize());
+            if (commit_.Due(false))
+            {
+                PrepareSync(false);
+            }
+            SubmitPending();
+            Reap(false);
+        }
+
+        // IOSQE_IO_DRAIN使fdatasync在此前提交的所有写入完成后才执行，因此各次落盘按提交顺序完成
+        void PrepareSync(bool force)
+        {
+            struct io_uring_sqe *sqe = NextSqe();
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fd = fd_;
+            sqe->flags = IOSQE_IO_DRAIN;
+            sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+            sqe->user_data = kSyncTag;
+            syncs_.push_back(commit_.Begin(force));
+            ++inflight_;
+        }
+
+        void PrepareWrite(Slot &slot)
+        {
+            slot.iov.iov_base = const_cast<char *>(slot.buffer.Begin()) + slot.done;
+            slot.iov.iov_len = slot.buffer.ReadableSize() - slot.done;
+            struct io_uring_sqe *sqe = NextSqe();
+            sqe->opcode = IORING_OP_WRITEV;
+            sqe->fd = fd_;
+            sqe->addr = reinterpret_cast<uint64_t>(&slot.iov);
+            sqe->len = 1;
+            sqe->off = slot.offset + slot.done;
+            sqe->user_data = &slot - slots_.data();
+            ++inflight_;
+        }
+
+        // 在途请求不超过队列容量，且每次提交后内核已取走提交项，因此总能取到空位
+        struct io_uring_sqe *NextSqe()
+        {
+            unsigned idx = (*sq_tail_ + sq_pending_++) & sq_mask_;
+            struct io_uring_sqe *sqe = &static_cast<struct io_uring_sqe *>(sqes_)[idx];
+            memset(sqe, 0, sizeof(*sqe));
+            sq_array_[idx] = idx;
+            return sqe;
+        }
+
+        // 提交项填写完毕后才发布给内核并提交
+        void SubmitPending()
+        {
+            unsigned n = sq_pending_;
+            __atomic_store_n(sq_tail_, *sq_tail_ + n, __ATOMIC_RELEASE);
+            sq_pending_ = 0;
+            EnterRing(n, 0);
+        }
+
+        void EnterRing(unsigned submit, unsigned wait)
+        {
+            while (Enter(ring_fd_, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0) < 0)
+            {
+                if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                {
+                    std::cout << __FILE__ << __LINE__ << "io_uring_enter failed" << std::endl;
+                    perror(NULL);
+                    return;
+                }
+            }
+        }
+
+        // 处理完成事件，释放写完的缓冲区，短写时提交剩余部分；wait为真时至少等到一个完成
+        void Reap(bool wait)
+        {
+            if (wait && *cq_head_ == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+            {
+                EnterRing(0, 1);
+            }
+            unsigned head = *cq_head_;
+            while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+            {
+                struct io_uring_cqe cqe = cqes_[head & cq_mask_];
+                __atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE);
+                --inflight_;
+                if (cqe.user_data == kSyncTag)
+                {
+                    if (cqe.res < 0)
+                    {
+                        std::cout << __FILE__ << __LINE__ << "fdatasync file " << filename_ << " failed: " << strerror(-cqe.res) << std::endl;
+                    }
+                    commit_.End(syncs_.front());
+                    syncs_.pop_front();
+                    continue;
+                }
+                Slot &slot = slots_[cqe.user_data];
+                if (cqe.res < 0 && cqe.res != -EINTR && cqe.res != -EAGAIN)
+                {
+                    std::cout << __FILE__ << __LINE__ << "write file " << filename_ << " failed: " << strerror(-cqe.res) << std::endl;
+                    Recover(slot);
+                    slot.busy = false;
+                    continue;
+                }
+                slot.done += cqe.res > 0 ? cqe.res : 0;
+                if (slot.done < slot.buffer.ReadableSize())
+                {
+                    PrepareWrite(slot); // 短写，续写剩余部分
+                    SubmitPending();
+                    continue;
+                }
+                slot.busy = false;
+            }
+        }
+
+        // 异步写入失败后同步重试剩余部分，避免文件中留下全零的区间
+        // 重试仍失败时计入lost_bytes_；该区间位于文件末尾(其后没有已分配的写入)时收回偏移，后续写入接着已写入的部分
+        void Recover(Slot &slot)
+        {
+            size_t len = slot.buffer.ReadableSize();
+            slot.done += WriteAt(slot.buffer.Begin() + slot.done, len - slot.done, slot.offset + slot.done);
+            if (slot.done == len)
+            {
+                return;
+            }
+            lost_bytes_.fetch_add(len - slot.done, std::memory_order_relaxed);
+            if (slot.offset + static_cast<off_t>(len) == offset_)
+            {
+                offset_ = slot.offset + slot.done;
+            }
+        }
+
+        // 在offset处同步写入，返回写入的字节数，出错时少于len
+        size_t WriteAt(const char *data, size_t len, off_t offset)
+        {
+            struct iovec iov;
+            iov.iov_base = const_cast<char *>(data);
+            iov.iov_len = len;
+            while (iov.iov_len > 0)
+            {
+                ssize_t n = pwritev(fd_, &iov, 1, offset + (len - iov.iov_len));
+                if (n <= 0)
+                {
+                    if (n < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+                    std::cout << __FILE__ << __LINE__ << "write file " << filename_ << " failed" << std::endl;
+                    perror(NULL);
+                    break;
+                }
+                iov.iov_base = static_cast<char *>(iov.iov_base) + n;
+                iov.iov_len -= n;
+            }
+            return len - iov.iov_len;
+        }
+
+        // 不支持io_uring时的同步写入
+        void WriteSync(const char *data, size_t len)
+        {
+            size_t n = WriteAt(data, len, offset_);
+            offset_ += n;
+            if (n < len)
+            {
+                lost_bytes_.fetch_add(len - n, std::memory_order_relaxed);
+                return;
+            }
+            commit_.Written(len);
+            Sync(false);
+        }
+
+    private:
+        std::string filename_;     // 文件名
+        int fd_ = -1;              // 文件描述符
+        off_t offset_ = 0;         // 下一次写入的文件偏移
+        std::vector<Slot> slots_;  // 写缓冲区，最多同时在途slots_.size()个
+        size_t inflight_ = 0;      // 已提交未完成的请求数
+        GroupCommit commit_;       // 落盘策略
+        std::deque<GroupCommit::Ticket> syncs_; // 在途的fdatasync，按提交顺序完成
+        std::atomic<uint64_t> lost_bytes_{0};   // 重试后仍未能写入的字节数
+
+        int ring_fd_ = -1;                    // io_uring描述符，小于0表示使用pwritev
+        size_t entries_ = 0;                  // 提交队列容量
+        void *sq_ptr_ = nullptr;              // 提交队列映射
+        void *cq_ptr_ = nullptr;              // 完成队列映射(可能与提交队列共用)
+        void *sqes_ = nullptr;                // 提交队列项数组
+        size_t sq_size_ = 0, cq_size_ = 0, sqes_size_ = 0;
+        unsigned *sq_tail_ = nullptr, *sq_array_ = nullptr, sq_mask_ = 0;
+        unsigned sq_pending_ = 0;             // 已填写未发布的提交项数
+        unsigned *cq_head_ = nullptr, *cq_tail_ = nullptr, cq_mask_ = 0;
+        struct io_uring_cqe *cqes_ = nullptr;
+    };
+}
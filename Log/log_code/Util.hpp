@@ -3,6 +3,8 @@
 #include <sys/types.h>
 #include <jsoncpp/json/json.h>
 #include <ctime>
+#include <cstring>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -19,6 +21,54 @@ namespace mylog
         public:
             // 获取当前时间
             static time_t Now() { return time(nullptr); }
+
+            // 获取当前时间(纳秒)，CLOCK_REALTIME走vDSO，不陷入内核
+            static int64_t NowNs()
+            {
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+            }
+
+            static constexpr size_t kTimeLen = 15; // "HH:MM:SS.uuuuuu"
+
+            // 将纳秒时间戳格式化为"时:分:秒.微秒"写入buf(至少kTimeLen字节)，返回写入长度
+            // 每个线程缓存当前秒的"HH:MM:SS"，只有跨秒时才调用localtime_r
+            static size_t FormatTime(int64_t ns, char *buf)
+            {
+                static thread_local time_t cached_sec = -1;
+                static thread_local char cached[8];
+                time_t sec = static_cast<time_t>(ns / 1000000000);
+                if (sec != cached_sec)
+                {
+                    struct tm t;
+                    localtime_r(&sec, &t);
+                    Put2(cached, t.tm_hour);
+                    cached[2] = ':';
+                    Put2(cached + 3, t.tm_min);
+                    cached[5] = ':';
+                    Put2(cached + 6, t.tm_sec);
+                    cached_sec = sec;
+                }
+                memcpy(buf, cached, 8);
+                buf[8] = '.';
+                uint32_t us = static_cast<uint32_t>(ns % 1000000000) / 1000;
+                Put2(buf + 9, us / 10000);
+                Put2(buf + 11, us / 100 % 100);
+                Put2(buf + 13, us % 100);
+                return kTimeLen;
+            }
+
+        private:
+            // 写入两位十进制数
+            static void Put2(char *p, uint32_t v)
+            {
+                static const char digits[] =
+                    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                    "8081828384858687888990919293949596979899";
+                memcpy(p, digits + v * 2, 2);
+            }
         };
 
         class File
@@ -57,7 +107,8 @@ namespace mylog
                     throw std::invalid_argument("Path cannot be empty");
                 }
                 std::error_code error;
-                if (!std::filesystem::create_directories(filename, error))
+                // 目录已存在时create_directories返回false但没有错误
+                if (!std::filesystem::create_directories(filename, error) && error)
                 {
                     throw std::runtime_error("Failed to create directory: " + error.message());
                 }
@@ -166,17 +217,59 @@ namespace mylog
                 flush_log = root["flush_log"].asInt64();
                 backup_addr = root["backup_addr"].asString();
                 backup_port = root["backup_port"].asInt();
+                backup_on_error = root["backup_on_error"].asBool();
                 thread_count = root["thread_count"].asInt();
+                staging_size = root["staging_size"].asInt64();
+                staging_interval = root["staging_interval"].asInt64();
+                sync_interval = root["sync_interval"].asInt64();
+                sync_bytes = root["sync_bytes"].asInt64();
+                sync_on_error = root["sync_on_error"].asBool();
+                buffer_block_size = root["buffer_block_size"].asInt64();
+                buffer_pool_bytes = root["buffer_pool_bytes"].asInt64();
+                use_hugepages = root["use_hugepages"].asBool();
+                worker_cpus = root["worker_cpus"].asString();
+                numa_per_node = root["numa_per_node"].asBool();
+                compress = root["compress"].asString();
+                compress_level = root["compress_level"].asInt();
+                compress_frame_size = root["compress_frame_size"].asInt64();
+                compress_threads = root["compress_threads"].asInt64();
+                roll_period = root["roll_period"].asString();
+                roll_max_files = root["roll_max_files"].asInt64();
+                roll_max_bytes = root["roll_max_bytes"].asInt64();
+                roll_preallocate = root["roll_preallocate"].asBool();
+                time_index = root["time_index"].asBool();
+                time_index_bucket = root["time_index_bucket"].asUInt();
             }
 
         public:
             size_t buffer_size;   // 缓冲区基础容量
             size_t threshold;     // 倍数扩容阈值
             size_t linear_growth; // 线性增长容量
-            size_t flush_log;     // 控制日志同步到磁盘的时机，默认为0,1调用fflush，2调用fsync
+            size_t flush_log;     // 控制日志同步到磁盘的时机，默认为0,1调用fflush，2调用fsync，3组提交(见sync_interval/sync_bytes)
             std::string backup_addr;
             uint16_t backup_port;
+            bool backup_on_error; // ERROR/FATAL日志另外发送到backup_addr:backup_port，服务器不可达时暂存到本地文件
             size_t thread_count;
+            size_t staging_size;     // 生产者线程暂存缓冲区大小，0表示不使用暂存
+            size_t staging_interval; // 暂存数据最长停留时间(毫秒)，0表示只在写满或显式刷新时提交
+            size_t sync_interval;    // 组提交：最早的未落盘数据最长等待时间(毫秒)
+            size_t sync_bytes;       // 组提交：未落盘数据达到该字节数时立即落盘
+            bool sync_on_error;      // ERROR/FATAL日志立即落盘，默认关闭；开启后每条ERROR日志多一次落盘请求，FATAL日志阻塞调用者直到落盘完成(最多1秒)
+            size_t buffer_block_size; // 缓冲区内存池的块大小，缓冲区大小取整到块的整数倍
+            size_t buffer_pool_bytes; // 内存池中空闲内存的上限，超出的部分归还系统；不限制使用中的缓冲区，其大小由溢出策略约束
+            bool use_hugepages;       // 缓冲区使用大页(优先预留大页，否则透明大页)
+            std::string worker_cpus;  // 日志器后台线程绑定的CPU列表，如"2-3"，为空表示不绑定
+            bool numa_per_node;       // 每个NUMA节点一个后台线程，缓冲区从本节点分配
+            std::string compress;       // 滚动出的日志文件的压缩算法："zstd"、"lz4"，为空表示不压缩
+            int compress_level;         // 压缩级别
+            size_t compress_frame_size; // 每个独立压缩帧的原始大小，按帧随机访问
+            size_t compress_threads;    // 同时压缩的文件数上限(在ThreadPool中执行)
+            std::string roll_period;    // 滚动文件按时间滚动："hourly"、"daily"，为空表示只按大小滚动
+            size_t roll_max_files;      // 滚动文件最多保留的文件数，0表示不限；正在写的文件和刚滚动出(可能正在压缩)的文件不会被删除
+            size_t roll_max_bytes;      // 滚动文件最多保留的总字节数，0表示不限
+            bool roll_preallocate;      // 用fallocate为新的滚动文件预留max_size字节的空间，默认关闭
+            bool time_index;            // 文件输出方式同时写时间索引(文件名.idx)，供log_query按时间和级别查询，默认关闭
+            uint32_t time_index_bucket; // 时间索引的桶宽(秒)
         };
     }
 }
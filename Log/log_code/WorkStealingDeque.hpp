@@ -0,0 +1,139 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace mylog
+{
+    // Chase-Lev工作窃取双端队列：所有者线程在底部压入/弹出，其他线程从顶部窃取，全程不加锁
+    // 元素必须可平凡拷贝(通常是指针)，空间不足时扩容为两倍，旧数组保留到队列析构，避免窃取者读到已释放的内存
+    template <typename T>
+    class WorkStealingDeque
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque requires trivially copyable elements");
+
+    public:
+        explicit WorkStealingDeque(size_t capacity = 256)
+            : top_(0), bottom_(0)
+        {
+            size_t cap = 16;
+            while (cap < capacity)
+            {
+                cap <<= 1;
+            }
+            arrays_.emplace_back(new Array(cap));
+            array_.store(arrays_.back().get(), std::memory_order_relaxed);
+        }
+
+        // 禁用拷贝和赋值
+        WorkStealingDeque(const WorkStealingDeque &) = delete;
+        WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+        // 所有者线程在底部压入
+        void Push(T item)
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed);
+            int64_t t = top_.load(std::memory_order_acquire);
+            Array *a = array_.load(std::memory_order_relaxed);
+            if (b - t > static_cast<int64_t>(a->capacity) - 1)
+            {
+                a = Grow(a, t, b);
+            }
+            a->Put(b, item);
+            // 发布元素；seq_cst与线程池检查休眠线程数构成Dekker同步，避免丢失唤醒
+            bottom_.store(b + 1, std::memory_order_seq_cst);
+        }
+
+        // 所有者线程从底部弹出，队列为空时返回false
+        bool Pop(T &item)
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+            Array *a = array_.load(std::memory_order_relaxed);
+            bottom_.store(b, std::memory_order_seq_cst);
+            int64_t t = top_.load(std::memory_order_seq_cst);
+            if (t > b)
+            {
+                bottom_.store(b + 1, std::memory_order_relaxed); // 队列为空
+                return false;
+            }
+            item = a->Get(b);
+            if (t == b)
+            {
+                // 最后一个元素，与窃取者竞争
+                bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        // 其他线程从顶部窃取，队列为空或竞争失败时返回false
+        bool Steal(T &item)
+        {
+            int64_t t = top_.load(std::memory_order_seq_cst);
+            int64_t b = bottom_.load(std::memory_order_seq_cst);
+            if (t >= b)
+            {
+                return false;
+            }
+            Array *a = array_.load(std::memory_order_acquire);
+            item = a->Get(t);
+            return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        }
+
+        // 队列是否为空(近似值，并发修改时仅供参考)
+        bool Empty() const
+        {
+            return bottom_.load(std::memory_order_seq_cst) <= top_.load(std::memory_order_seq_cst);
+        }
+
+        // 队列中的元素数(近似值)
+        size_t Size() const
+        {
+            int64_t n = bottom_.load(std::memory_order_relaxed) - top_.load(std::memory_order_relaxed);
+            return n > 0 ? static_cast<size_t>(n) : 0;
+        }
+
+    private:
+        // 环形数组，元素用relaxed原子读写，由top_/bottom_的同步保证可见性
+        struct Array
+        {
+            explicit Array(size_t cap) : capacity(cap), mask(cap - 1), items(new std::atomic<T>[cap]) {}
+
+            T Get(int64_t i) const
+            {
+                return items[i & mask].load(std::memory_order_relaxed);
+            }
+
+            void Put(int64_t i, T item)
+            {
+                items[i & mask].store(item, std::memory_order_relaxed);
+            }
+
+            size_t capacity;
+            size_t mask;
+            std::unique_ptr<std::atomic<T>[]> items;
+        };
+
+        // 扩容为两倍，只有所有者线程调用
+        Array *Grow(Array *old, int64_t t, int64_t b)
+        {
+            Array *a = new Array(old->capacity * 2);
+            for (int64_t i = t; i < b; ++i)
+            {
+                a->Put(i, old->Get(i));
+            }
+            arrays_.emplace_back(a);
+            array_.store(a, std::memory_order_release);
+            return a;
+        }
+
+    private:
+        alignas(64) std::atomic<int64_t> top_;    // 窃取端
+        alignas(64) std::atomic<int64_t> bottom_; // 所有者端
+        std::atomic<Array *> array_;              // 当前数组
+        std::vector<std::unique_ptr<Array>> arrays_; // 所有分配过的数组(仅所有者线程修改)
+    };
+}
@@ -0,0 +1,191 @@
+// ThreadPool任务提交的堆分配测试：替换全局operator new/delete计数，预热后enqueue/post不应再分配堆内存
+// 覆盖Task内联存放的小任务、从SmallBlockPool分配的大任务，以及PoolAllocator分配共享状态的enqueue
+// 编译: g++ -std=c++17 -O2 alloc_test.cpp -o alloc_test -lpthread
+// 用法: ./alloc_test [-s]   -s启用work stealing
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <new>
+#include <vector>
+#include "ThreadPool.hpp"
+
+static std::atomic<uint64_t> g_allocs{0};
+
+static void *CountedAlloc(size_t size, size_t align = 0)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = nullptr;
+    if (align > alignof(std::max_align_t))
+    {
+        if (posix_memalign(&p, align, size ? size : 1) != 0)
+        {
+            p = nullptr;
+        }
+    }
+    else
+    {
+        p = malloc(size ? size : 1);
+    }
+    return p;
+}
+
+// 不内联，避免编译器把new与free配对检查时误报
+__attribute__((noinline)) static void CountedFree(void *p)
+{
+    free(p);
+}
+
+void *operator new(size_t size)
+{
+    void *p = CountedAlloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return CountedAlloc(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return CountedAlloc(size); }
+void *operator new(size_t size, std::align_val_t align)
+{
+    void *p = CountedAlloc(size, static_cast<size_t>(align));
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void *operator new[](size_t size, std::align_val_t align) { return operator new(size, align); }
+void operator delete(void *p) noexcept { CountedFree(p); }
+void operator delete[](void *p) noexcept { CountedFree(p); }
+void operator delete(void *p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void *p, size_t) noexcept { CountedFree(p); }
+void operator delete(void *p, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { CountedFree(p); }
+
+static constexpr int kTasks = 10000; // 每轮提交的任务数
+static constexpr int kBatch = 256;   // 每批提交后等待完成，限制同时排队的任务数，使队列和内存池的用量有上界
+static constexpr int kWarmup = 3;    // 预热轮数，让队列和各线程的本地缓存达到稳定大小
+
+// 执行round(warmup)轮后再执行一轮，返回最后一轮的堆分配次数
+template <typename Round>
+static uint64_t Measure(Round round)
+{
+    for (int i = 0; i < kWarmup; ++i)
+    {
+        round();
+    }
+    uint64_t before = g_allocs.load();
+    round();
+    return g_allocs.load() - before;
+}
+
+// 预先向SmallBlockPool的全局链表填入足够的块：排队的任务加上各线程缓存(每个最多2 * kBatch块)最多占用约一千块，
+// 否则块在线程缓存之间的分布偶尔达到新的峰值时还会向系统申请一批，测试结果不稳定
+static void FillPool()
+{
+    std::vector<void *> blocks;
+    for (size_t cls = 0; cls < mylog::SmallBlockPool::kClasses; ++cls)
+    {
+        size_t size = mylog::SmallBlockPool::kMinBlock << cls;
+        for (int i = 0; i < 4096; ++i)
+        {
+            blocks.push_back(mylog::SmallBlockPool::GetInstance().Allocate(size));
+        }
+        for (void *p : blocks)
+        {
+            mylog::SmallBlockPool::GetInstance().Deallocate(p, size);
+        }
+        blocks.clear();
+    }
+}
+
+// 等待计数器达到n
+static void WaitFor(std::atomic<int> &counter, int n)
+{
+    while (counter.load(std::memory_order_acquire) < n)
+    {
+        std::this_thread::yield();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ThreadPoolOptions options;
+    options.thread_count = 4;
+    options.work_stealing = argc > 1 && strcmp(argv[1], "-s") == 0;
+    ThreadPool &pool = ThreadPool::GetInstance(options);
+    FillPool();
+
+    std::atomic<int> counter{0};
+    std::vector<std::future<int>> futures;
+    futures.reserve(kBatch);
+    int failed = 0;
+    auto check = [&failed](const char *name, uint64_t allocs)
+    {
+        printf("%-24s %llu allocations per %d tasks\n", name, static_cast<unsigned long long>(allocs), kTasks);
+        if (allocs != 0)
+        {
+            failed = 1;
+        }
+    };
+
+    // 捕获不超过Task::kInlineSize的任务直接存放在Task内部
+    check("post (inline)", Measure([&]()
+                                   {
+                                       counter = 0;
+                                       for (int i = 0; i < kTasks; ++i)
+                                       {
+                                           pool.post([&counter]() { counter.fetch_add(1, std::memory_order_release); });
+                                           if ((i + 1) % kBatch == 0)
+                                           {
+                                               WaitFor(counter, i + 1);
+                                           }
+                                       }
+                                       WaitFor(counter, kTasks); }));
+
+    // 超过kInlineSize的捕获从SmallBlockPool分配
+    check("post (pooled)", Measure([&]()
+                                   {
+                                       counter = 0;
+                                       char payload[96] = {1};
+                                       for (int i = 0; i < kTasks; ++i)
+                                       {
+                                           pool.post([&counter, payload]() { counter.fetch_add(payload[0], std::memory_order_release); });
+                                           if ((i + 1) % kBatch == 0)
+                                           {
+                                               WaitFor(counter, i + 1);
+                                           }
+                                       }
+                                       WaitFor(counter, kTasks); }));
+
+    // promise的共享状态由PoolAllocator分配
+    check("enqueue (promise)", Measure([&]()
+                                       {
+                                           long sum = 0;
+                                           for (int i = 0; i < kTasks; ++i)
+                                           {
+                                               futures.push_back(pool.enqueue([](int x) { return x + 1; }, i));
+                                               if (futures.size() == kBatch || i + 1 == kTasks)
+                                               {
+                                                   for (auto &f : futures)
+                                                   {
+                                                       sum += f.get();
+                                                   }
+                                                   futures.clear();
+                                               }
+                                           }
+                                           if (sum != static_cast<long>(kTasks) * (kTasks + 1) / 2)
+                                           {
+                                               printf("wrong result %ld\n", sum);
+                                               std::exit(1);
+                                           } }));
+
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
@@ -0,0 +1,35 @@
+// 二进制日志解码工具：将BinaryFileFlush写出的文件还原为文本日志
+// 编译: g++ -std=c++17 log_decoder.cpp -o log_decoder
+// 用法: ./log_decoder file1.binlog [file2.binlog ...] > out.log
+#include <iostream>
+#include <string>
+#include "BinaryFile.hpp"
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " file.binlog..." << std::endl;
+        return 1;
+    }
+    int ret = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string content;
+        mylog::Util::File file;
+        if (!file.GetContent(&content, argv[i]))
+        {
+            ret = 1;
+            continue;
+        }
+        std::string text;
+        mylog::binfile::Decoder decoder;
+        if (!decoder.Decode(content.data(), content.size(), text))
+        {
+            std::cerr << argv[i] << ": corrupted or truncated binary log" << std::endl;
+            ret = 1;
+        }
+        std::cout.write(text.data(), text.size());
+    }
+    return ret;
+}
@@ -0,0 +1,270 @@
+// 文本日志查询工具：借助时间索引(文件名.idx)只读取时间范围内、含有指定级别的时间桶，不扫描整个文件
+// 支持SegmentCompressor压缩后的文件(.zst/.lz4)，只解压相关的帧；没有索引时退回全文件扫描
+// 编译: g++ -std=c++17 log_query.cpp -o log_query [-lzstd] [-llz4]
+// 用法: ./log_query [-f 开始时间] [-t 结束时间] [-l 最低级别] file.log...
+//   时间为"YYYY-MM-DD HH:MM:SS"、"HH:MM:SS"(当天)或秒级时间戳，级别为DEBUG/INFO/WARN/ERROR/FATAL
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Compress.hpp"
+#include "TimeIndex.hpp"
+
+using namespace mylog;
+
+// 日志文件的原始内容，普通文件直接mmap，压缩文件按需解压覆盖所读区间的帧
+class Segment
+{
+public:
+    ~Segment()
+    {
+        if (map_ != nullptr)
+        {
+            munmap(map_, len_);
+        }
+    }
+
+    bool Open(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            perror(path.c_str());
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return false;
+        }
+        len_ = st.st_size;
+        mtime_ = st.st_mtime;
+        if (len_ > 0)
+        {
+            void *p = mmap(NULL, len_, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                perror(path.c_str());
+                close(fd);
+                return false;
+            }
+            map_ = static_cast<char *>(p);
+        }
+        close(fd);
+        type_ = SeekableCompressor::TypeOfFile(path);
+        if (type_ == CompressType::NONE)
+        {
+            size_ = len_;
+            return true;
+        }
+        if (!SeekableCompressor::Available(type_))
+        {
+            std::cerr << path << ": built without support for this compression" << std::endl;
+            return false;
+        }
+        if (!SeekableCompressor::ReadTable(map_, len_, frames_))
+        {
+            std::cerr << path << ": missing seek table" << std::endl;
+            return false;
+        }
+        size_ = frames_.empty() ? 0 : frames_.back().raw_offset + frames_.back().raw_size;
+        return true;
+    }
+
+    // 原始内容的大小
+    uint64_t Size() const { return size_; }
+
+    // 文件修改时间，没有索引时作为换算行时间的参照
+    time_t MTime() const { return mtime_; }
+
+    // 原始内容中[begin, end)的部分
+    std::string_view Read(uint64_t begin, uint64_t end)
+    {
+        end = std::min(end, size_);
+        if (begin >= end)
+        {
+            return std::string_view();
+        }
+        if (type_ == CompressType::NONE)
+        {
+            return std::string_view(map_ + begin, end - begin);
+        }
+        if (begin < buf_begin_ || end > buf_begin_ + buf_.size())
+        {
+            // 解压覆盖[begin, end)的连续帧
+            auto first = std::upper_bound(frames_.begin(), frames_.end(), begin, [](uint64_t v, const SeekableCompressor::Frame &f)
+                                          { return v < f.raw_offset; }) - 1;
+            auto last = std::lower_bound(frames_.begin(), frames_.end(), end, [](const SeekableCompressor::Frame &f, uint64_t v)
+                                         { return f.raw_offset < v; });
+            buf_begin_ = first->raw_offset;
+            buf_.resize((last - 1)->raw_offset + (last - 1)->raw_size - buf_begin_);
+            for (auto it = first; it != last; ++it)
+            {
+                if (!SeekableCompressor::DecompressFrame(type_, map_ + it->offset, it->size, &buf_[it->raw_offset - buf_begin_], it->raw_size))
+                {
+                    std::cerr << "corrupted frame at " << it->offset << std::endl;
+                    buf_.clear();
+                    return std::string_view();
+                }
+            }
+        }
+        return std::string_view(buf_.data() + (begin - buf_begin_), end - begin);
+    }
+
+private:
+    char *map_ = nullptr;
+    size_t len_ = 0;
+    uint64_t size_ = 0;
+    time_t mtime_ = 0;
+    CompressType type_ = CompressType::NONE;
+    std::vector<SeekableCompressor::Frame> frames_;
+    std::string buf_;         // 解压出的连续帧
+    uint64_t buf_begin_ = 0;  // buf_在原始内容中的偏移
+};
+
+struct Query
+{
+    int64_t from = std::numeric_limits<int64_t>::min();
+    int64_t to = std::numeric_limits<int64_t>::max();
+    int min_level = 0;
+};
+
+// 输出text中时间和级别符合条件的行，ref为换算行时间的参照时间；多行消息的后续行跟随其首行
+static void Scan(std::string_view text, int64_t ref, const Query &q)
+{
+    int ref_sec = timeindex::SecondOfDay(ref);
+    bool keep = false;
+    const char *p = text.data();
+    const char *end = p + text.size();
+    while (p < end)
+    {
+        const char *nl = static_cast<const char *>(memchr(p, '\n', end - p));
+        size_t n = nl ? nl - p + 1 : end - p;
+        int sec, level;
+        if (timeindex::ParseLine(p, n, sec, level))
+        {
+            int64_t t = timeindex::ToTime(ref, ref_sec, sec);
+            keep = t >= q.from && t < q.to && level >= q.min_level;
+        }
+        if (keep)
+        {
+            fwrite(p, 1, n, stdout);
+        }
+        p += n;
+    }
+}
+
+// 日志文件对应的索引：压缩后的文件与原文件共用"原文件名.idx"
+static std::string IndexPath(const std::string &path)
+{
+    size_t pos = path.rfind(".log");
+    return (pos == std::string::npos ? path : path.substr(0, pos + 4)) + ".idx";
+}
+
+static bool QueryFile(const std::string &path, const Query &q)
+{
+    Segment segment;
+    if (!segment.Open(path))
+    {
+        return false;
+    }
+    timeindex::Reader index;
+    if (!index.Open(IndexPath(path)))
+    {
+        Scan(segment.Read(0, segment.Size()), segment.MTime(), q);
+        return true;
+    }
+    uint32_t mask = ~0u << q.min_level;
+    for (size_t i = index.LowerBound(q.from); i < index.Count(); ++i)
+    {
+        const timeindex::Entry &e = index.At(i);
+        if (e.start - timeindex::kSlack >= q.to)
+        {
+            break;
+        }
+        if ((e.levels & mask) == 0)
+        {
+            continue; // 桶内没有要找的级别，不读取
+        }
+        uint64_t end = i + 1 < index.Count() ? index.At(i + 1).offset : segment.Size();
+        Scan(segment.Read(e.offset, end), e.start, q);
+    }
+    return true;
+}
+
+// 解析"YYYY-MM-DD HH:MM:SS"、"HH:MM:SS"(当天)或秒级时间戳
+static bool ParseTime(const char *s, int64_t &t)
+{
+    struct tm tm;
+    time_t now = time(nullptr);
+    localtime_r(&now, &tm);
+    const char *end = strptime(s, "%Y-%m-%d %H:%M:%S", &tm);
+    if (end == nullptr || *end != '\0')
+    {
+        localtime_r(&now, &tm);
+        end = strptime(s, "%H:%M:%S", &tm);
+    }
+    if (end != nullptr && *end == '\0')
+    {
+        tm.tm_isdst = -1;
+        t = mktime(&tm);
+        return true;
+    }
+    char *num_end;
+    t = strtoll(s, &num_end, 10);
+    return *s != '\0' && *num_end == '\0';
+}
+
+static int ParseLevel(const std::string &s)
+{
+    const char *names[] = {"DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+    for (int i = 0; i < 5; ++i)
+    {
+        if (s == names[i])
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    Query q;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-f" || arg == "-t" || arg == "-l") && i + 1 < argc)
+        {
+            const char *value = argv[++i];
+            bool ok = arg == "-f" ? ParseTime(value, q.from) : arg == "-t" ? ParseTime(value, q.to) : (q.min_level = ParseLevel(value)) >= 0;
+            if (!ok)
+            {
+                std::cerr << "invalid value for " << arg << ": " << value << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        files.push_back(arg);
+    }
+    if (files.empty())
+    {
+        std::cerr << "usage: " << argv[0] << " [-f from] [-t to] [-l level] file.log..." << std::endl;
+        return 1;
+    }
+    int ret = 0;
+    for (auto &file : files)
+    {
+        if (!QueryFile(file, q))
+        {
+            ret = 1;
+        }
+    }
+    return ret;
+}